@@ -0,0 +1,225 @@
+#ifndef BROADCAST_RING_H
+#define BROADCAST_RING_H 1
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "ring_buffer.h"
+#include "wait.h"
+
+// BroadcastRing is single-producer multi-consumer ring where every consumer reads every value.
+// Producer writes each value once and never waits for consumers, consumers only keep their read cursor.
+// Consumer that was lapped by producer has overflowed.
+// Size is rounded up to power of two.
+//
+// Slot points to node holding the value, publish swaps in node with the new value so that
+// consumer that is copying the previous one (even if it was preempted) keeps it until it is done.
+// Node is recycled by whoever drops its last reference after it was replaced.
+// Nodes are only freed with the ring, so consumer may reference node that was recycled meanwhile,
+// it then finds out that node is no longer in its slot with its cursor and treats it as overflow.
+template<typename T>
+class BroadcastRing {
+public:
+    explicit BroadcastRing(std::size_t size, WaitStrategy wait = {}): slots(std::bit_ceil(size)), mask(slots.size() - 1), wait(wait) {};
+
+    BroadcastRing(const BroadcastRing&) = delete;
+    BroadcastRing& operator=(const BroadcastRing&) = delete;
+
+    // position returns cursor of the next value to be published
+    inline std::size_t position() const { return write_pos.load(std::memory_order_acquire); };
+
+    // publish overwrites the oldest value in the ring
+    void publish(T value);
+
+    // read value at cursor
+    // Returns State::valid and value if value was published before deadline.
+    // If producer has lapped the cursor then State::overflow is returned immediately.
+    // If no value was published before deadline then State::timeout is returned.
+    PopResult<T> read(std::size_t cursor, std::optional<std::chrono::steady_clock::time_point> deadline);
+
+    // read up to max_n values starting at cursor to out, waiting for at least one value
+    // States are returned as for single value read, values read before overflow was detected are kept in out.
+    PopState read(std::size_t cursor, std::vector<T>& out, std::size_t max_n, std::optional<std::chrono::steady_clock::time_point> deadline);
+
+    // watch arms watch to be invoked once value at cursor is published
+    // Returns false without arming watch if value at cursor was already published.
+    bool watch(std::size_t cursor, Signal::Watch& watch) {
+        return signal.watch(watch, [this, cursor] { return write_pos.load(std::memory_order_acquire) != cursor; });
+    };
+
+private:
+    // node was replaced in its slot and is recycled once it has no references
+    static constexpr std::uint32_t retired = 1u << 30;
+    // node was recycled, guards against recycling it twice
+    static constexpr std::uint32_t recycled = 1u << 31;
+    static constexpr std::uint32_t refs_mask = retired - 1;
+
+    struct Node {
+        // number of consumers referencing node with retired and recycled flags
+        std::atomic<std::uint32_t> refs{0};
+        std::atomic<std::size_t> cursor{0};
+        T value;
+        Node* next = nullptr;
+    };
+
+    struct Slot {
+        std::atomic<Node*> node{nullptr};
+    };
+
+    std::vector<Slot> slots;
+    const std::size_t mask;
+    const WaitStrategy wait;
+
+    alignas(cache_line_size) std::atomic<std::size_t> write_pos{0};
+    // all nodes ever allocated and nodes that producer can reuse, only touched by producer
+    std::vector<std::unique_ptr<Node>> nodes;
+    Node* spare = nullptr;
+
+    // nodes recycled by consumers, taken by producer all at once
+    alignas(cache_line_size) std::atomic<Node*> free{nullptr};
+
+    alignas(cache_line_size) Signal signal;
+
+    Node* acquire_node();
+    void release(Node* node);
+    void recycle(Node* node);
+    bool copy(std::size_t cursor, T& dst);
+};
+
+template<typename T>
+void BroadcastRing<T>::publish(T value) {
+    auto pos = write_pos.load(std::memory_order_relaxed);
+    auto& slot = slots[pos & mask];
+
+    auto node = acquire_node();
+    node->value = std::move(value);
+    node->cursor.store(pos, std::memory_order_relaxed);
+
+    // consumers that still reference previous node keep it, it is recycled once they release it
+    auto previous = slot.node.exchange(node, std::memory_order_seq_cst);
+    if (previous != nullptr && (previous->refs.fetch_or(retired, std::memory_order_seq_cst) & refs_mask) == 0) {
+        recycle(previous);
+    };
+
+    write_pos.store(pos + 1, std::memory_order_release);
+
+    signal.notify();
+}
+
+template<typename T>
+PopResult<T> BroadcastRing<T>::read(std::size_t cursor, std::optional<std::chrono::steady_clock::time_point> deadline) {
+    auto ready = [this, cursor] { return write_pos.load(std::memory_order_acquire) != cursor; };
+
+    if (!signal.wait_until(wait, ready, deadline)) {
+        return {std::nullopt, PopState::timeout};
+    }
+
+    if (write_pos.load(std::memory_order_acquire) - cursor > slots.size()) {
+        return {std::nullopt, PopState::overflow};
+    }
+
+    T value;
+    if (!copy(cursor, value)) {
+        return {std::nullopt, PopState::overflow};
+    }
+
+    return {std::move(value), PopState::valid};
+}
+
+template<typename T>
+PopState BroadcastRing<T>::read(std::size_t cursor, std::vector<T>& out, std::size_t max_n, std::optional<std::chrono::steady_clock::time_point> deadline) {
+    auto ready = [this, cursor] { return write_pos.load(std::memory_order_acquire) != cursor; };
+
+    if (!signal.wait_until(wait, ready, deadline)) {
+        return PopState::timeout;
+    }
+
+    auto pos = write_pos.load(std::memory_order_acquire);
+    if (pos - cursor > slots.size()) {
+        return PopState::overflow;
+    }
+
+    auto n = std::min(pos - cursor, max_n);
+    for (std::size_t i = 0; i < n; i++) {
+        if (!copy(cursor + i, out.emplace_back())) {
+            out.pop_back();
+            return PopState::overflow;
+        }
+    }
+
+    return PopState::valid;
+}
+
+template<typename T>
+bool BroadcastRing<T>::copy(std::size_t cursor, T& dst) {
+    auto& slot = slots[cursor & mask];
+
+    auto node = slot.node.load(std::memory_order_acquire);
+    if (node == nullptr) {
+        return false;
+    };
+
+    node->refs.fetch_add(1, std::memory_order_seq_cst);
+
+    // node was replaced before reference was taken or slot was overwritten after position has been checked
+    if (slot.node.load(std::memory_order_seq_cst) != node || node->cursor.load(std::memory_order_relaxed) != cursor) {
+        release(node);
+        return false;
+    };
+
+    dst = node->value;
+    release(node);
+
+    return true;
+}
+
+template<typename T>
+typename BroadcastRing<T>::Node* BroadcastRing<T>::acquire_node() {
+    if (spare == nullptr) {
+        spare = free.exchange(nullptr, std::memory_order_acquire);
+    };
+
+    // all nodes are in slots or referenced by consumers
+    if (spare == nullptr) {
+        nodes.push_back(std::make_unique<Node>());
+        return nodes.back().get();
+    };
+
+    auto node = spare;
+    spare = node->next;
+
+    // references of consumers that found node recycled are kept until they release them
+    node->refs.fetch_and(refs_mask, std::memory_order_relaxed);
+
+    return node;
+}
+
+template<typename T>
+void BroadcastRing<T>::release(Node* node) {
+    if (node->refs.fetch_sub(1, std::memory_order_acq_rel) == (retired | 1)) {
+        recycle(node);
+    };
+}
+
+template<typename T>
+void BroadcastRing<T>::recycle(Node* node) {
+    // retired node may be released concurrently by consumer that found it replaced
+    auto expected = retired;
+    if (!node->refs.compare_exchange_strong(expected, retired | recycled, std::memory_order_acq_rel)) {
+        return;
+    };
+
+    // value is released as soon as the last consumer is done with it
+    node->value = T{};
+
+    node->next = free.load(std::memory_order_relaxed);
+    while (!free.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) { }
+}
+
+#endif
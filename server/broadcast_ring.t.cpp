@@ -0,0 +1,212 @@
+#include "broadcast_ring.h"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+namespace {
+    auto deadline(int ms) {
+        return std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    };
+} // anonymous namespace
+
+TEST_CASE( "BroadcastRing read", "[broadcast_ring]" ) {
+    BroadcastRing<int> ring{4};
+
+    SECTION( "every cursor reads every value" ) {
+        ring.publish(1);
+        ring.publish(2);
+
+        for (std::size_t cursor: {0, 0}) {
+            REQUIRE( *ring.read(cursor, deadline(10)).value == 1 );
+            REQUIRE( *ring.read(cursor + 1, deadline(10)).value == 2 );
+        }
+    }
+
+    SECTION( "timeout when cursor reached producer" ) {
+        ring.publish(1);
+
+        REQUIRE( ring.position() == 1 );
+        REQUIRE( ring.read(1, deadline(10)).state == PopState::timeout );
+    }
+
+    SECTION( "batch read returns available values" ) {
+        ring.publish(1);
+        ring.publish(2);
+        ring.publish(3);
+
+        std::vector<int> out;
+
+        REQUIRE( ring.read(1, out, 8, deadline(10)) == PopState::valid );
+        REQUIRE( out == std::vector<int>{2, 3} );
+        REQUIRE( ring.read(3, out, 8, deadline(10)) == PopState::timeout );
+    }
+
+    SECTION( "overflow when cursor was lapped" ) {
+        for (int i = 0; i < 5; i++) {
+            ring.publish(i);
+        }
+
+        REQUIRE( ring.read(0, deadline(10)).state == PopState::overflow );
+        REQUIRE( *ring.read(1, deadline(10)).value == 1 );
+    }
+}
+
+TEST_CASE( "BroadcastRing transfers values to multiple consumers", "[broadcast_ring]" ) {
+    constexpr int count = 10000;
+
+    // ring fits all values so that slow consumers are not lapped
+    BroadcastRing<int> ring{count};
+
+    std::vector<std::future<bool>> consumers;
+    for (int i = 0; i < 4; i++) {
+        consumers.emplace_back(std::async(std::launch::async, [&ring] {
+            for (std::size_t cursor = 0; cursor < count; cursor++) {
+                auto [res, state] = ring.read(cursor, deadline(10000));
+                if (state != PopState::valid || *res != static_cast<int>(cursor)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }));
+    }
+
+    for (int i = 0; i < count; i++) {
+        ring.publish(i);
+    }
+
+    for (auto& consumer: consumers) {
+        REQUIRE( consumer.get() );
+    }
+}
+
+TEST_CASE( "BroadcastRing producer laps concurrent consumers", "[broadcast_ring]" ) {
+    constexpr int count = 100000;
+
+    // small ring of shared values is overwritten while consumers copy them
+    BroadcastRing<std::shared_ptr<const int>> ring{8};
+
+    std::atomic<bool> done{false};
+
+    std::vector<std::future<bool>> consumers;
+    for (int i = 0; i < 4; i++) {
+        consumers.emplace_back(std::async(std::launch::async, [&] {
+            std::size_t cursor = 0;
+            while (!done) {
+                auto [res, state] = ring.read(cursor, deadline(10));
+                if (state == PopState::overflow) {
+                    cursor = ring.position();
+                    continue;
+                };
+
+                if (state == PopState::valid) {
+                    // consumer never observes value of another cursor
+                    if (**res != static_cast<int>(cursor)) {
+                        return false;
+                    };
+
+                    cursor++;
+                };
+            };
+
+            return true;
+        }));
+    }
+
+    for (int i = 0; i < count; i++) {
+        ring.publish(std::make_shared<const int>(i));
+    }
+
+    done = true;
+
+    for (auto& consumer: consumers) {
+        REQUIRE( consumer.get() );
+    }
+}
+
+TEST_CASE( "BroadcastRing watch", "[broadcast_ring]" ) {
+    BroadcastRing<int> ring{4};
+
+    int woken = 0;
+    Signal::Watch watch{[&woken] { woken++; }};
+
+    SECTION( "watch is invoked once by publish" ) {
+        REQUIRE( ring.watch(0, watch) );
+
+        ring.publish(1);
+        ring.publish(2);
+
+        REQUIRE( woken == 1 );
+    }
+
+    SECTION( "watch is not armed if value was already published" ) {
+        ring.publish(1);
+
+        REQUIRE( !ring.watch(0, watch) );
+        REQUIRE( ring.watch(1, watch) );
+
+        ring.publish(2);
+
+        REQUIRE( woken == 1 );
+    }
+
+    SECTION( "destroyed watch is disarmed" ) {
+        {
+            Signal::Watch other{[&woken] { woken++; }};
+            REQUIRE( ring.watch(0, other) );
+        }
+
+        ring.publish(1);
+
+        REQUIRE( woken == 0 );
+    }
+}
+
+TEST_CASE( "BroadcastRing watch does not miss values", "[broadcast_ring]" ) {
+    constexpr int count = 100000;
+
+    BroadcastRing<int> ring{count};
+
+    // consumer never blocks in read, it waits for watch when it caught up with producer
+    std::atomic<bool> woken{false};
+    Signal::Watch watch{[&woken] { woken = true; }};
+
+    auto consumer = std::async(std::launch::async, [&] {
+        std::size_t cursor = 0;
+        std::vector<int> out;
+
+        while (cursor < count) {
+            out.clear();
+
+            if (ring.read(cursor, out, 256, std::chrono::steady_clock::now()) == PopState::valid) {
+                cursor += out.size();
+                continue;
+            };
+
+            woken = false;
+            if (!ring.watch(cursor, watch)) {
+                continue;
+            };
+
+            auto timeout = deadline(10000);
+            while (!woken) {
+                if (std::chrono::steady_clock::now() > timeout) {
+                    return false;
+                };
+                std::this_thread::yield();
+            };
+        };
+
+        return true;
+    });
+
+    for (int i = 0; i < count; i++) {
+        ring.publish(i);
+    }
+
+    REQUIRE( consumer.get() );
+}
@@ -1,6 +1,14 @@
 #include "client.h"
 
+#include <atomic>
+#include <chrono>
 #include <future>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include <boost/asio/connect.hpp>
 #include <boost/asio/ip/tcp.hpp>
@@ -14,6 +22,7 @@
 #include <boost/beast/websocket/ssl.hpp>
 
 #include "subscriptions.h"
+#include "../ring_buffer.h"
 
 namespace net = boost::asio;
 namespace ssl = boost::asio::ssl;
@@ -25,46 +34,183 @@ using tcp = boost::asio::ip::tcp;
 
 namespace coinbase {
 
-ClientImpl::ClientImpl(boost::asio::io_context& ioc, std::string rest_host, std::string websocket_host): rest_host(rest_host), websocket_host(websocket_host), ioc(ioc), sslc(ssl::context::sslv23), resolver(ioc) {
+namespace {
+
+// number of received full channel frames waiting to be parsed
+constexpr std::size_t frame_buffer_size = 4096;
+
+// maximum number of frames parsed per wakeup
+constexpr std::size_t parse_batch_size = 64;
+
+// size of chunks of orderbook body decoded as they arrive
+constexpr std::size_t orderbook_chunk_size = 65536;
+
+// split_endpoint splits "host[:port]" into host and port, port defaults to 443
+std::pair<std::string, std::string> split_endpoint(const std::string& endpoint) {
+    auto pos = endpoint.rfind(':');
+    if (pos == std::string::npos) {
+        return {endpoint, "443"};
+    };
+
+    return {endpoint.substr(0, pos), endpoint.substr(pos + 1)};
+};
+
+} // anonymous namespace
+
+// RestConnection is keep-alive TLS connection to REST endpoint,
+// read buffer is kept with the connection since it can hold bytes of the next response
+struct ClientImpl::RestConnection {
+    RestConnection(net::io_context& ioc, ssl::context& sslc): stream(ioc, sslc) {};
+
+    beast::ssl_stream<beast::tcp_stream> stream;
+    beast::flat_buffer buffer;
+    // number of completed requests, reused connection could have been closed by server while idle
+    std::size_t requests = 0;
+};
+
+ClientImpl::ClientImpl(boost::asio::io_context& ioc, std::string rest_endpoint, std::string websocket_host): rest_endpoint(rest_endpoint), rest_host(split_endpoint(rest_endpoint).first), rest_port(split_endpoint(rest_endpoint).second), websocket_host(websocket_host), ioc(ioc), sslc(ssl::context::sslv23), resolver(ioc) {
     sslc.set_default_verify_paths();
 };
 
+ClientImpl::~ClientImpl() = default;
+
 OrderBook ClientImpl::get_orderbook(std::string product) {
-    beast::ssl_stream<beast::tcp_stream> stream(ioc, sslc);
+    auto target = "/products/" + product + "/book?level=3";
+
+    while (true) {
+        auto conn = acquire_rest();
+        auto reused = conn->requests > 0;
+
+        try {
+            return request_orderbook(std::move(conn), target);
+        } catch (const boost::beast::system_error&) {
+            // request is idempotent, so it is retried if idle connection was closed by server
+            if (!reused) {
+                throw;
+            };
+        };
+    };
+};
+
+OrderBook ClientImpl::request_orderbook(std::unique_ptr<RestConnection> conn, const std::string& target) {
+    // write request
+    http::request<http::empty_body> req{http::verb::get, target, 11};
+    req.set(http::field::host, rest_endpoint);
+    req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+    req.keep_alive(true);
+
+    http::write(conn->stream, req);
+
+    // read response, body is decoded in chunks as it arrives instead of being buffered whole
+    http::response_parser<http::buffer_body> res;
+    res.body_limit(std::numeric_limits<std::uint64_t>::max());
+
+    http::read_header(conn->stream, conn->buffer, res);
+    if (res.get().result() != http::status::ok) {
+        throw std::runtime_error("orderbook request failed with status " + std::to_string(res.get().result_int()));
+    };
+
+    OrderBookParser orderbook;
+    std::vector<char> chunk(orderbook_chunk_size);
+
+    while (!res.is_done()) {
+        res.get().body().data = chunk.data();
+        res.get().body().size = chunk.size();
+
+        beast::error_code ec;
+        http::read(conn->stream, conn->buffer, res, ec);
+        if (ec && ec != http::error::need_buffer) {
+            throw boost::beast::system_error{ec};
+        };
+
+        orderbook.write({chunk.data(), chunk.size() - res.get().body().size});
+    };
+
+    conn->requests++;
+
+    if (res.keep_alive()) {
+        release_rest(std::move(conn));
+    } else {
+        close_rest(*conn);
+    };
+
+    return orderbook.finish();
+};
+
+std::unique_ptr<ClientImpl::RestConnection> ClientImpl::acquire_rest() {
+    boost::asio::ip::tcp::resolver::results_type endpoints;
+    std::shared_ptr<SSL_SESSION> session;
+
+    {
+        std::unique_lock lock{rest_mtx};
+
+        if (!rest_idle.empty()) {
+            auto conn = std::move(rest_idle.back());
+            rest_idle.pop_back();
+            return conn;
+        };
+
+        if (!rest_endpoints) {
+            rest_endpoints = resolver.resolve(rest_host, rest_port);
+        };
+
+        endpoints = *rest_endpoints;
+        session = rest_session;
+    }
+
+    auto conn = std::make_unique<RestConnection>(ioc, sslc);
 
     // setup SNI
-    if (!SSL_set_tlsext_host_name(stream.native_handle(), rest_host.c_str())) {
+    if (!SSL_set_tlsext_host_name(conn->stream.native_handle(), rest_host.c_str())) {
         beast::error_code ec{static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()};
         throw beast::system_error{ec};
     }
 
-    // resolve https address
-    auto const results = resolver.resolve(rest_host, "443");
+    // resumed session skips certificate exchange and key agreement of full handshake
+    if (session) {
+        SSL_set_session(conn->stream.native_handle(), session.get());
+    };
 
-    // connect and perform ssl handshake
-    beast::get_lowest_layer(stream).connect(results);
-    stream.handshake(ssl::stream_base::client);
+    try {
+        beast::get_lowest_layer(conn->stream).connect(endpoints);
+    } catch (...) {
+        // resolve again on next attempt in case endpoint moved
+        std::unique_lock lock{rest_mtx};
+        rest_endpoints.reset();
+        throw;
+    };
 
-    // write request
-    http::request<http::string_body> req{http::verb::get, "/products/" + product + "/book?level=3", 11};
-    req.set(http::field::host, rest_host);
-    req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+    conn->stream.handshake(ssl::stream_base::client);
 
-    http::write(stream, req);
+    return conn;
+};
 
-    // read response
-    beast::flat_buffer buffer;
-    http::response<http::string_body> res;
+void ClientImpl::release_rest(std::unique_ptr<RestConnection> conn) {
+    save_rest_session(*conn);
+
+    std::unique_lock lock{rest_mtx};
+    rest_idle.push_back(std::move(conn));
+};
 
-    http::read(stream, buffer, res);
+void ClientImpl::close_rest(RestConnection& conn) {
+    save_rest_session(conn);
 
     beast::error_code ec;
-    stream.shutdown(ec);
-    if (ec && ec != net::error::eof && ec != ec == ssl::error::stream_truncated) {
+    conn.stream.shutdown(ec);
+    if (ec && ec != net::error::eof && ec != ssl::error::stream_truncated) {
         throw boost::beast::system_error{ec};
     }
+};
+
+void ClientImpl::save_rest_session(RestConnection& conn) {
+    // session is taken after response was read, since TLS 1.3 sends session tickets after handshake
+    std::shared_ptr<SSL_SESSION> session{SSL_get1_session(conn.stream.native_handle()), SSL_SESSION_free};
+    if (!session || !SSL_SESSION_is_resumable(session.get())) {
+        return;
+    };
 
-    return parse_orderbook(res.body());
+    std::unique_lock lock{rest_mtx};
+    rest_session = std::move(session);
 };
 
 std::future<void> ClientImpl::subscribe_full(std::vector<std::string> products, std::function<void(const Full&)> callback) {
@@ -108,16 +254,65 @@ std::future<void> ClientImpl::subscribe_full(std::vector<std::string> products,
 
     // this fails due to stream going out of scope
     return std::async(std::launch::async, [callback, stream = std::move(stream)]() mutable {
-        while (true) {
-            beast::flat_buffer buffer;
+        // receive stage only reads frames so that socket is drained while parse stage decodes them
+        // frame strings are recycled by parse stage, their capacity is reused for next frames
+        RingBuffer<std::string> frames{frame_buffer_size};
+        RingBuffer<std::string> recycled{2 * frame_buffer_size};
+        std::atomic<bool> receiving{true};
+
+        auto parser = std::async(std::launch::async, [&] {
+            // parsed message is reused so that its strings keep capacity
+            Full full;
+
+            std::vector<std::string> batch;
+            batch.reserve(parse_batch_size);
+
+            while (true) {
+                batch.clear();
+
+                // flag is read before drain, so that timeout after receive stage ended means that buffer is drained
+                auto received = !receiving.load();
+
+                auto state = frames.drain(batch, parse_batch_size, std::chrono::milliseconds(100));
+                if (state == PopState::overflow) {
+                    throw std::runtime_error("frame buffer overflow");
+                };
+
+                if (state == PopState::timeout) {
+                    if (received) {
+                        return;
+                    };
+                    continue;
+                };
+
+                for (auto& data: batch) {
+                    parse_full(data, full);
+                    callback(full);
+
+                    recycled.push(std::move(data));
+                };
+            };
+        });
 
-            buffer.clear();
-            stream.read(buffer);
+        beast::flat_buffer buffer;
 
-            auto data = beast::buffers_to_string(buffer.cdata());
-            auto full = parse_full(data);
+        try {
+            // receive until parse stage fails
+            while (parser.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                buffer.clear();
+                stream.read(buffer);
 
-            callback(full);
+                auto frame = recycled.pop_wait(std::chrono::seconds(0)).value.value_or(std::string{});
+                frame.assign(static_cast<const char*>(buffer.cdata().data()), buffer.size());
+
+                if (!frames.push(std::move(frame))) {
+                    throw std::runtime_error("frame buffer overflow");
+                };
+            };
+        } catch (...) {
+            receiving = false;
+            parser.wait();
+            throw;
         };
 
         try {
@@ -127,6 +322,8 @@ std::future<void> ClientImpl::subscribe_full(std::vector<std::string> products,
                 throw exc;
             };
         };
+
+        parser.get();
     });
 };
 
@@ -4,7 +4,11 @@
 #include <cstdint>
 #include <functional>
 #include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/tcp.hpp>
@@ -22,16 +26,36 @@ struct Client {
 
 class ClientImpl: public Client {
 public:
-   ClientImpl(boost::asio::io_context& ioc, std::string rest_host, std::string websocket_host);
+   // rest_endpoint is host with optional port, port defaults to 443
+   ClientImpl(boost::asio::io_context& ioc, std::string rest_endpoint, std::string websocket_host);
+   ~ClientImpl();
 
+   // get_orderbook is safe to call concurrently.
+   // Requests reuse idle keep-alive connections, new connections resume TLS session of the previous one.
    virtual OrderBook get_orderbook(std::string product);
    virtual std::future<void> subscribe_full(std::vector<std::string> products, std::function<void(const Full&)> callback);
 private:
+   struct RestConnection;
+
+   const std::string rest_endpoint;
    const std::string rest_host;
+   const std::string rest_port;
    const std::string websocket_host;
    boost::asio::io_context& ioc;
    boost::asio::ssl::context sslc;
    boost::asio::ip::tcp::resolver resolver;
+
+   // pool of idle REST connections, endpoints resolved once and the last TLS session
+   std::mutex rest_mtx;
+   std::vector<std::unique_ptr<RestConnection>> rest_idle;
+   std::optional<boost::asio::ip::tcp::resolver::results_type> rest_endpoints;
+   std::shared_ptr<SSL_SESSION> rest_session;
+
+   std::unique_ptr<RestConnection> acquire_rest();
+   void release_rest(std::unique_ptr<RestConnection> conn);
+   void close_rest(RestConnection& conn);
+   void save_rest_session(RestConnection& conn);
+   OrderBook request_orderbook(std::unique_ptr<RestConnection> conn, const std::string& target);
 };
 
 } // namespace coinbase
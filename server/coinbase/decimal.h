@@ -1,11 +1,12 @@
 #ifndef COINBASE_DECIMAL_H
 #define COINBASE_DECIMAL_H 1
 
-#include <boost/multiprecision/cpp_dec_float.hpp>
+#include "../decimal.h"
 
 namespace coinbase {
 
-using Decimal = boost::multiprecision::number<boost::multiprecision::cpp_dec_float<8>>;
+// feed values are parsed straight into fixed-point representation used by orderbooks
+using Decimal = ::Decimal;
 
 }; // namespace coinbase
 
@@ -1,21 +1,31 @@
 #include "full.h"
 
+#include <array>
+#include <charconv>
 #include <unordered_map>
 
 #include <boost/json.hpp>
 
+#include "../scan.h"
+
 namespace coinbase {
 
 namespace {
 
 Decimal decimal_from_key(const boost::json::object& obj, const char* key) {
     if (obj.contains(key)) {
-        return Decimal{boost::json::value_to<std::string>(obj.at(key))};
+        const auto& str = obj.at(key).as_string();
+        return Decimal{std::string_view{str.data(), str.size()}};
     }
 
     return Decimal{};
 };
 
+OrderId order_id_from_value(const boost::json::value& src) {
+    const auto& str = src.as_string();
+    return OrderId{std::string_view{str.data(), str.size()}};
+};
+
 static std::unordered_map<std::string, Full::Type> full_type_names = {
     {"received", Full::Type::Received},
     {"open", Full::Type::Open},
@@ -25,14 +35,387 @@ static std::unordered_map<std::string, Full::Type> full_type_names = {
     {"activate", Full::Type::Activate},
 };
 
+// Field is value of key read by FullReader, it views message unless string had to be unescaped
+struct Field {
+    std::string_view value;
+    std::string unescaped;
+    bool present = false;
+};
+
+// FullReader scans flat json object of full channel message and keeps fields of known keys.
+// Fields are collected before payload is built, since type does not have to be the first key.
+// Values of unknown keys are skipped without decoding, nested objects and arrays included.
+class FullReader {
+public:
+    enum class Key: std::size_t {
+        Type,
+        Time,
+        ProductId,
+        Sequence,
+        Side,
+        OrderId,
+        OrderType,
+        Size,
+        Price,
+        Funds,
+        RemainingSize,
+        Reason,
+        MakerOrderId,
+        TakerOrderId,
+        OldSize,
+        NewSize,
+        OldFunds,
+        NewFunds,
+    };
+
+    static constexpr std::size_t key_count = static_cast<std::size_t>(Key::NewFunds) + 1;
+
+    explicit FullReader(std::string_view data): _pos(data.data()), _end(data.data() + data.size()) {};
+
+    void read();
+
+    inline const Field& operator[](Key key) const { return _fields[static_cast<std::size_t>(key)]; };
+
+private:
+    static constexpr std::array<std::string_view, key_count> names = {
+        "type", "time", "product_id", "sequence", "side",
+        "order_id", "order_type", "size", "price", "funds", "remaining_size", "reason",
+        "maker_order_id", "taker_order_id", "old_size", "new_size", "old_funds", "new_funds",
+    };
+
+    const char* _pos;
+    const char* _end;
+    std::array<Field, key_count> _fields;
+
+    [[noreturn]] static void malformed() { throw std::invalid_argument("malformed full message"); };
+
+    void skip_whitespace();
+    void expect(char c);
+    bool consume(char c);
+
+    // string returns contents of string at cursor, escaped is set if contents have to be unescaped
+    std::string_view string(bool& escaped);
+    void unescape(std::string_view src, std::string& dst);
+
+    void read_value(Field* field);
+    void skip_scalar();
+    void skip_nested();
+};
+
+void FullReader::read() {
+    expect('{');
+    if (consume('}')) {
+        return;
+    };
+
+    do {
+        bool escaped = false;
+        auto name = string(escaped);
+        expect(':');
+
+        // escaped names never match known keys
+        Field* field = nullptr;
+        for (std::size_t key = 0; key < key_count && !escaped; key++) {
+            if (names[key] == name) {
+                field = &_fields[key];
+                break;
+            };
+        };
+
+        read_value(field);
+    } while (consume(','));
+
+    expect('}');
+};
+
+void FullReader::skip_whitespace() {
+    while (_pos < _end && (*_pos == ' ' || *_pos == '\t' || *_pos == '\n' || *_pos == '\r')) {
+        _pos++;
+    };
+};
+
+void FullReader::expect(char c) {
+    if (!consume(c)) {
+        malformed();
+    };
+};
+
+bool FullReader::consume(char c) {
+    skip_whitespace();
+    if (_pos == _end || *_pos != c) {
+        return false;
+    };
+
+    _pos++;
+    return true;
+};
+
+std::string_view FullReader::string(bool& escaped) {
+    expect('"');
+
+    auto begin = _pos;
+    while ((_pos = find_string_end(_pos, _end)) < _end && *_pos == '\\') {
+        escaped = true;
+        _pos += 2;
+    };
+
+    if (_pos >= _end) {
+        malformed();
+    };
+
+    return {begin, static_cast<std::size_t>(_pos++ - begin)};
+};
+
+void FullReader::unescape(std::string_view src, std::string& dst) {
+    dst.clear();
+
+    for (std::size_t i = 0; i < src.size(); i++) {
+        if (src[i] != '\\') {
+            dst.push_back(src[i]);
+            continue;
+        };
+
+        switch (src[++i]) {
+        case 'b': dst.push_back('\b'); break;
+        case 'f': dst.push_back('\f'); break;
+        case 'n': dst.push_back('\n'); break;
+        case 'r': dst.push_back('\r'); break;
+        case 't': dst.push_back('\t'); break;
+        case 'u': {
+            unsigned int code = 0;
+            if (i + 4 >= src.size() || std::from_chars(&src[i + 1], &src[i + 5], code, 16).ptr != &src[i + 5]) {
+                malformed();
+            };
+            i += 4;
+
+            // surrogate pairs are not combined, values of read keys are plain ascii
+            if (code < 0x80) {
+                dst.push_back(static_cast<char>(code));
+            } else if (code < 0x800) {
+                dst.push_back(static_cast<char>(0xc0 | (code >> 6)));
+                dst.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+            } else {
+                dst.push_back(static_cast<char>(0xe0 | (code >> 12)));
+                dst.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+                dst.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+            };
+            break;
+        };
+        default: dst.push_back(src[i]); break;
+        };
+    };
+};
+
+void FullReader::read_value(Field* field) {
+    skip_whitespace();
+    if (_pos == _end) {
+        malformed();
+    };
+
+    switch (*_pos) {
+    case '"': {
+        bool escaped = false;
+        auto value = string(escaped);
+        if (field == nullptr) {
+            return;
+        };
+
+        if (escaped) {
+            unescape(value, field->unescaped);
+            value = field->unescaped;
+        };
+
+        field->value = value;
+        field->present = true;
+        return;
+    };
+    case '{':
+    case '[':
+        skip_nested();
+        return;
+    default: {
+        auto begin = _pos;
+        skip_scalar();
+
+        // null is treated as missing key
+        std::string_view value{begin, static_cast<std::size_t>(_pos - begin)};
+        if (field != nullptr && value != "null") {
+            field->value = value;
+            field->present = true;
+        };
+        return;
+    };
+    };
+};
+
+void FullReader::skip_scalar() {
+    auto begin = _pos;
+    while (_pos < _end && *_pos != ',' && *_pos != '}' && *_pos != ']' && *_pos != ' ' && *_pos != '\t' && *_pos != '\n' && *_pos != '\r') {
+        _pos++;
+    };
+
+    if (_pos == begin) {
+        malformed();
+    };
+};
+
+void FullReader::skip_nested() {
+    std::size_t depth = 0;
+
+    do {
+        skip_whitespace();
+        if (_pos == _end) {
+            malformed();
+        };
+
+        switch (*_pos) {
+        case '{':
+        case '[':
+            depth++; _pos++; break;
+        case '}':
+        case ']':
+            depth--; _pos++; break;
+        case '"': {
+            bool escaped = false;
+            string(escaped);
+            break;
+        };
+        case ',':
+        case ':':
+            _pos++; break;
+        default:
+            skip_scalar(); break;
+        };
+    } while (depth > 0);
+};
+
+std::string_view required(const FullReader& reader, FullReader::Key key) {
+    const auto& field = reader[key];
+    if (!field.present) {
+        throw std::invalid_argument("missing key in full message");
+    };
+
+    return field.value;
+};
+
+Decimal decimal(const FullReader& reader, FullReader::Key key) {
+    const auto& field = reader[key];
+    return field.present ? Decimal{field.value} : Decimal{};
+};
+
+OrderId order_id(const FullReader& reader, FullReader::Key key) {
+    return OrderId{required(reader, key)};
+};
+
+void assign(std::string& dst, const FullReader& reader, FullReader::Key key) {
+    const auto& field = reader[key];
+    if (field.present) {
+        dst.assign(field.value);
+    } else {
+        dst.clear();
+    };
+};
+
+Full::Type full_type(std::string_view name) {
+    for (const auto& [type_name, type]: full_type_names) {
+        if (type_name == name) {
+            return type;
+        };
+    };
+
+    throw std::invalid_argument("unsupported Full::Type value");
+};
+
+// payload returns payload of dst holding T, existing payload is reused so that its strings keep capacity
+template <typename T>
+T& payload(Full& dst) {
+    if (!std::holds_alternative<T>(dst.payload)) {
+        dst.payload.emplace<T>();
+    };
+
+    return std::get<T>(dst.payload);
+};
+
 } // anonymous namespace
 
 void FullVisitor::apply(const Full& full) {
     std::visit([&](const auto& v) { visit(full, v); }, full.payload);
 };
 
-Full parse_full(std::string data) {
-    return boost::json::value_to<Full>(boost::json::parse(data));
+void parse_full(std::string_view data, Full& dst) {
+    using Key = FullReader::Key;
+
+    FullReader reader{data};
+    reader.read();
+
+    auto sequence = required(reader, Key::Sequence);
+    if (std::from_chars(sequence.data(), sequence.data() + sequence.size(), dst.sequence).ptr != sequence.data() + sequence.size()) {
+        throw std::invalid_argument("malformed sequence in full message");
+    };
+
+    dst.type = full_type(required(reader, Key::Type));
+    assign(dst.time, reader, Key::Time);
+    assign(dst.product_id, reader, Key::ProductId);
+    assign(dst.side, reader, Key::Side);
+
+    switch (dst.type) {
+    case Full::Type::Received: {
+        auto& received = payload<Received>(dst);
+        received.order_id = order_id(reader, Key::OrderId);
+        assign(received.order_type, reader, Key::OrderType);
+        received.size = decimal(reader, Key::Size);
+        received.price = decimal(reader, Key::Price);
+        received.funds = decimal(reader, Key::Funds);
+        break;
+    };
+    case Full::Type::Open: {
+        auto& open = payload<Open>(dst);
+        open.order_id = order_id(reader, Key::OrderId);
+        open.price = decimal(reader, Key::Price);
+        open.remaining_size = decimal(reader, Key::RemainingSize);
+        break;
+    };
+    case Full::Type::Done: {
+        auto& done = payload<Done>(dst);
+        done.order_id = order_id(reader, Key::OrderId);
+        done.price = decimal(reader, Key::Price);
+        done.remaining_size = decimal(reader, Key::RemainingSize);
+        assign(done.reason, reader, Key::Reason);
+        break;
+    };
+    case Full::Type::Match: {
+        auto& match = payload<Match>(dst);
+        match.maker_order_id = order_id(reader, Key::MakerOrderId);
+        match.taker_order_id = order_id(reader, Key::TakerOrderId);
+        match.price = decimal(reader, Key::Price);
+        match.size = decimal(reader, Key::Size);
+        break;
+    };
+    case Full::Type::Change: {
+        auto& change = payload<Change>(dst);
+        change.order_id = order_id(reader, Key::OrderId);
+        change.price = decimal(reader, Key::Price);
+        change.old_size = decimal(reader, Key::OldSize);
+        change.new_size = decimal(reader, Key::NewSize);
+        change.old_funds = decimal(reader, Key::OldFunds);
+        change.new_funds = decimal(reader, Key::NewFunds);
+        break;
+    };
+    case Full::Type::Activate:
+        payload<Activate>(dst);
+        break;
+    };
+};
+
+Full parse_full(std::string_view data) {
+    Full dst;
+    parse_full(data, dst);
+
+    return dst;
+};
+
+Full parse_full_dom(std::string_view data, boost::json::storage_ptr sp) {
+    return boost::json::value_to<Full>(boost::json::parse({data.data(), data.size()}, std::move(sp)));
 };
 
 Full tag_invoke(boost::json::value_to_tag<Full>, boost::json::value const& src) {
@@ -74,10 +457,10 @@ Full::Type tag_invoke(boost::json::value_to_tag<Full::Type>, boost::json::value
 }
 
 Received tag_invoke(boost::json::value_to_tag<Received>, boost::json::value const& src) {
-    auto obj = src.as_object();
+    const auto& obj = src.as_object();
     
     return {
-        .order_id = boost::json::value_to<std::string>(obj.at("order_id")),
+        .order_id = order_id_from_value(obj.at("order_id")),
         .order_type = boost::json::value_to<std::string>(obj.at("order_type")),
         .size = decimal_from_key(obj, "size"),
         .price = decimal_from_key(obj, "price"),
@@ -87,17 +470,17 @@ Received tag_invoke(boost::json::value_to_tag<Received>, boost::json::value cons
 
 Open tag_invoke(boost::json::value_to_tag<Open>, boost::json::value const& src) {
     return Open{
-        .order_id = boost::json::value_to<std::string>(src.at("order_id")),
+        .order_id = order_id_from_value(src.at("order_id")),
         .price = Decimal{boost::json::value_to<std::string>(src.at("price"))},
         .remaining_size = Decimal{boost::json::value_to<std::string>(src.at("remaining_size"))}
     };
 }
 
 Done tag_invoke(boost::json::value_to_tag<Done>, boost::json::value const& src) {
-    auto obj = src.as_object();
+    const auto& obj = src.as_object();
 
     return {
-        .order_id = boost::json::value_to<std::string>(obj.at("order_id")),
+        .order_id = order_id_from_value(obj.at("order_id")),
         .price = decimal_from_key(obj, "price"),
         .remaining_size = decimal_from_key(obj, "remaining_size"),
         .reason = boost::json::value_to<std::string>(obj.at("reason")),
@@ -106,18 +489,18 @@ Done tag_invoke(boost::json::value_to_tag<Done>, boost::json::value const& src)
 
 Match tag_invoke(boost::json::value_to_tag<Match>, boost::json::value const& src) {
     return {
-        .maker_order_id = boost::json::value_to<std::string>(src.at("maker_order_id")),
-        .taker_order_id = boost::json::value_to<std::string>(src.at("taker_order_id")),
+        .maker_order_id = order_id_from_value(src.at("maker_order_id")),
+        .taker_order_id = order_id_from_value(src.at("taker_order_id")),
         .price = Decimal{boost::json::value_to<std::string>(src.at("price"))},
         .size = Decimal{boost::json::value_to<std::string>(src.at("size"))},
     };
 }
 
 Change tag_invoke(boost::json::value_to_tag<Change>, boost::json::value const& src) {
-    auto obj = src.as_object();
+    const auto& obj = src.as_object();
 
     return {
-        .order_id = boost::json::value_to<std::string>(obj.at("order_id")),
+        .order_id = order_id_from_value(obj.at("order_id")),
         .price = decimal_from_key(obj, "price"),
         .old_size = decimal_from_key(obj, "old_size"),
         .new_size = decimal_from_key(obj, "new_size"),
@@ -165,7 +548,7 @@ std::ostream& operator<<(std::ostream& os, const Full::Type& v) {
 }
 
 std::ostream& operator<<(std::ostream& os, const Received& v) {
-    return os << std::setprecision(std::numeric_limits<Decimal>::max_digits10) << "{" <<
+    return os << "{" <<
         ".order_id=" << v.order_id << ", " <<
         ".order_type=" << v.order_type << ", " <<
         ".size=" << v.size << ", " <<
@@ -175,7 +558,7 @@ std::ostream& operator<<(std::ostream& os, const Received& v) {
 }
 
 std::ostream& operator<<(std::ostream& os, const Open& v) {
-    return os << std::setprecision(std::numeric_limits<Decimal>::max_digits10) << "{" <<
+    return os << "{" <<
         ".order_id=" << v.order_id << ", " <<
         ".price=" << v.price << ", " <<
         ".remaining_size=" << v.remaining_size <<
@@ -183,7 +566,7 @@ std::ostream& operator<<(std::ostream& os, const Open& v) {
 }
 
 std::ostream& operator<<(std::ostream& os, const Done& v) {
-    return os << std::setprecision(std::numeric_limits<Decimal>::max_digits10) << "{" <<
+    return os << "{" <<
         ".order_id=" << v.order_id << ", " <<
         ".price=" << v.price << ", " <<
         ".remaining_size=" << v.remaining_size << ", " <<
@@ -192,7 +575,7 @@ std::ostream& operator<<(std::ostream& os, const Done& v) {
 }
 
 std::ostream& operator<<(std::ostream& os, const Match& v) {
-    return os << std::setprecision(std::numeric_limits<Decimal>::max_digits10) << "{" <<
+    return os << "{" <<
         ".maker_order_id=" << v.maker_order_id << ", " <<
         ".taker_order_id=" << v.taker_order_id << ", " <<
         ".price=" << v.price << ", " <<
@@ -201,7 +584,7 @@ std::ostream& operator<<(std::ostream& os, const Match& v) {
 }
 
 std::ostream& operator<<(std::ostream& os, const Change& v) {
-    return os << std::setprecision(std::numeric_limits<Decimal>::max_digits10) << "{" <<
+    return os << "{" <<
         ".order_id=" << v.order_id << ", " <<
         ".price=" << v.price << ", " <<
         ".old_size=" << v.old_size << ", " <<
@@ -7,15 +7,19 @@
 #include <ostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <variant>
 
+#include <boost/json/storage_ptr.hpp>
+
 #include "decimal.h"
+#include "order_id.h"
 #include "time.h"
 
 namespace coinbase {
 
 struct Received {
-    std::string order_id;
+    OrderId order_id;
     std::string order_type;
     Decimal size;
     Decimal price;
@@ -25,7 +29,7 @@ struct Received {
 };
 
 struct Open {
-    std::string order_id;
+    OrderId order_id;
     Decimal price;
     Decimal remaining_size;
 
@@ -33,7 +37,7 @@ struct Open {
 };
 
 struct Done {
-    std::string order_id;
+    OrderId order_id;
     Decimal price;
     Decimal remaining_size;
     std::string reason;
@@ -42,8 +46,8 @@ struct Done {
 };
 
 struct Match {
-    std::string maker_order_id;
-    std::string taker_order_id;
+    OrderId maker_order_id;
+    OrderId taker_order_id;
     Decimal price;
     Decimal size;
 
@@ -51,7 +55,7 @@ struct Match {
 };
 
 struct Change {
-    std::string order_id;
+    OrderId order_id;
     Decimal price;
     Decimal old_size;
     Decimal new_size;
@@ -99,7 +103,15 @@ struct FullVisitor {
     virtual void visit(const Full&, const Activate&) {};
 };
 
-Full parse_full(std::string data);
+// parse_full decodes message straight from data into dst without building json document.
+// Strings of dst keep their capacity, so Full reused for every message does not allocate.
+// Only keys of Full and its payloads are read, values of other keys are skipped.
+// throws std::invalid_argument if message is malformed or required key is missing
+void parse_full(std::string_view data, Full& dst);
+Full parse_full(std::string_view data);
+
+// parse_full_dom converts json document allocated from sp, it is reference implementation of parse_full
+Full parse_full_dom(std::string_view data, boost::json::storage_ptr sp = {});
 
 std::ostream& operator<<(std::ostream& os, const Full& v);
 std::ostream& operator<<(std::ostream& os, const Full::Type& v);
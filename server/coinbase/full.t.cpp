@@ -1,9 +1,26 @@
 #include "full.h"
 
+#include <string>
+#include <vector>
+
 #include <catch2/catch.hpp>
 
 using namespace coinbase;
 
+namespace {
+
+// hand-written samples shaped as full channel messages, with fields parser skips
+const std::vector<std::string> samples = {
+    R"json({"type":"received","side":"buy","product_id":"BTC-USD","time":"2021-04-19T12:31:04.291522Z","sequence":24375633734,"profile_id":"8b7d6a52-21b1-4d8a-9b1e-6a01b4e1e1d3","user_id":"5c4d5d6c0f2ab4b1e5b4e1d3","order_id":"7a5e9c2b-3f2d-4d6b-9f63-2b0a4f7d8e91","order_type":"limit","size":"0.01540000","price":"56123.45","client_oid":"6d2a1d9e-5b0b-4c1f-8a3d-0a6e1b2c3d4e"})json",
+    R"json({"type":"open","side":"buy","product_id":"BTC-USD","time":"2021-04-19T12:31:04.291522Z","sequence":24375633735,"price":"56123.45","order_id":"7a5e9c2b-3f2d-4d6b-9f63-2b0a4f7d8e91","remaining_size":"0.01540000"})json",
+    R"json({"type":"match","side":"sell","product_id":"BTC-USD","time":"2021-04-19T12:31:04.301522Z","sequence":24375633736,"trade_id":163473522,"maker_order_id":"ac928c66-ca53-498f-9c13-a110027a60e8","taker_order_id":"132fb6ae-456b-4654-b4e0-d681ac05cea1","size":"0.00400000","price":"56120.01"})json",
+    R"json({"type":"done","side":"sell","product_id":"BTC-USD","time":"2021-04-19T12:31:04.301522Z","sequence":24375633737,"order_id":"ac928c66-ca53-498f-9c13-a110027a60e8","reason":"filled","price":"56120.01","remaining_size":"0.00000000"})json",
+    R"json({"type":"change","side":"buy","product_id":"BTC-USD","time":"2021-04-19T12:31:04.311522Z","sequence":24375633738,"order_id":"7a5e9c2b-3f2d-4d6b-9f63-2b0a4f7d8e91","new_size":"0.01000000","old_size":"0.01540000","price":"56123.45"})json",
+    R"json({"type":"done","side":"buy","product_id":"BTC-USD","time":"2021-04-19T12:31:04.321522Z","sequence":24375633739,"order_id":"7a5e9c2b-3f2d-4d6b-9f63-2b0a4f7d8e91","reason":"canceled","price":"56123.45","remaining_size":"0.01000000"})json",
+};
+
+} // anonymous namespace
+
 TEST_CASE( "Full is unmarshalled ", "[Full]" ) {
     SECTION( "Received (limit)" ) {
         auto data = R"json({"type":"received","time":"2014-11-07T08:19:27.028459Z","product_id":"BTC-USD","sequence":10,"order_id":"d50ec984-77a8-460a-b958-66f114b0de9b","size":"1.34","price":"502.1","side":"buy","order_type":"limit"})json";
@@ -42,6 +59,25 @@ TEST_CASE( "Full is unmarshalled ", "[Full]" ) {
         } );
     }
 
+    SECTION( "Received (market) with funds past precision" ) {
+        auto data = R"json({"type":"received","time":"2014-11-09T08:19:27.028459Z","product_id":"BTC-USD","sequence":12,"order_id":"dddec984-77a8-460a-b958-66f114b0de9b","funds":"3000.234192254","side":"buy","order_type":"market" })json";
+        auto full = parse_full(data);
+
+        REQUIRE( full == Full{
+            .type = Full::Type::Received,
+            .time = "2014-11-09T08:19:27.028459Z",
+            .product_id = "BTC-USD",
+            .sequence = 12,
+            .side = "buy",
+            .payload = Received{
+                .order_id = "dddec984-77a8-460a-b958-66f114b0de9b",
+                .order_type = "market",
+                // funds are rounded to precision
+                .funds = Decimal("3000.23419225"),
+            },
+        } );
+    }
+
     SECTION( "Open" ) {
         auto data = R"json({"type":"open","time":"2014-11-07T08:19:27.028459Z","product_id":"BTC-USD","sequence":10,"order_id":"d50ec984-77a8-460a-b958-66f114b0de9b","price":"200.2","remaining_size":"1.00","side":"sell"})json";
         auto full = parse_full(data);
@@ -115,4 +151,96 @@ TEST_CASE( "Full is unmarshalled ", "[Full]" ) {
             },
         } );
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE( "Full is unmarshalled into reused Full", "[Full]" ) {
+    Full full;
+
+    SECTION( "payload of other type is replaced" ) {
+        parse_full(R"json({"type":"done","time":"2014-11-07T08:19:27.028459Z","product_id":"BTC-USD","sequence":10,"order_id":"d50ec984-77a8-460a-b958-66f114b0de9b","reason":"canceled","side":"sell","remaining_size":"1.5","price":"200.2"})json", full);
+        parse_full(R"json({"type":"open","time":"2014-11-07T08:19:28.028459Z","product_id":"ETH-USD","sequence":11,"order_id":"ac928c66-ca53-498f-9c13-a110027a60e8","price":"20.2","remaining_size":"3","side":"buy"})json", full);
+
+        REQUIRE( full == Full{
+            .type = Full::Type::Open,
+            .time = "2014-11-07T08:19:28.028459Z",
+            .product_id = "ETH-USD",
+            .sequence = 11,
+            .side = "buy",
+            .payload = Open{
+                .order_id = "ac928c66-ca53-498f-9c13-a110027a60e8",
+                .price = Decimal{"20.2"},
+                .remaining_size = Decimal{"3"},
+            },
+        } );
+    }
+
+    SECTION( "missing keys of payload are reset" ) {
+        parse_full(R"json({"type":"received","time":"t","product_id":"BTC-USD","sequence":10,"order_id":"d50ec984-77a8-460a-b958-66f114b0de9b","size":"1.34","price":"502.1","side":"buy","order_type":"limit"})json", full);
+        parse_full(R"json({"type":"received","time":"t","product_id":"BTC-USD","sequence":11,"order_id":"dddec984-77a8-460a-b958-66f114b0de9b","funds":"3000.234","side":"buy","order_type":"market"})json", full);
+
+        REQUIRE( std::get<Received>(full.payload) == Received{
+            .order_id = "dddec984-77a8-460a-b958-66f114b0de9b",
+            .order_type = "market",
+            .funds = Decimal{"3000.234"},
+        } );
+    }
+
+    SECTION( "unknown keys, whitespace, nulls and escapes" ) {
+        parse_full(R"json( {
+            "type" : "done", "profile_id": null, "meta": {"a": [1, {"b": "}"}], "c": "\"" },
+            "time":"2014-11-07T08:19:27.028459Z", "product_id":"BTC\u002dUSD", "sequence": 12,
+            "order_id":"d50ec984-77a8-460a-b958-66f114b0de9b", "reason": "fil\"led", "price": null, "side": "sell", "private": true
+        } )json", full);
+
+        REQUIRE( full == Full{
+            .type = Full::Type::Done,
+            .time = "2014-11-07T08:19:27.028459Z",
+            .product_id = "BTC-USD",
+            .sequence = 12,
+            .side = "sell",
+            .payload = Done{
+                .order_id = "d50ec984-77a8-460a-b958-66f114b0de9b",
+                .reason = "fil\"led",
+            },
+        } );
+    }
+
+    SECTION( "malformed message" ) {
+        REQUIRE_THROWS_AS( parse_full(R"json({"type":"done","sequence":10)json", full), std::invalid_argument );
+        REQUIRE_THROWS_AS( parse_full(R"json({"type":"done","sequence":10,"order_id":"d50ec984-77a8-460a-b958-66f114b0de9b","reason":"filled)json", full), std::invalid_argument );
+        REQUIRE_THROWS_AS( parse_full(R"json({"type":"done","sequence":"x","order_id":"d50ec984-77a8-460a-b958-66f114b0de9b"})json", full), std::invalid_argument );
+        REQUIRE_THROWS_AS( parse_full(R"json({"type":"done","order_id":"d50ec984-77a8-460a-b958-66f114b0de9b"})json", full), std::invalid_argument );
+        REQUIRE_THROWS_AS( parse_full(R"json({"type":"unknown","sequence":10})json", full), std::invalid_argument );
+    }
+}
+
+TEST_CASE( "Full parser matches json document", "[Full]" ) {
+    for (const auto& frame: samples) {
+        REQUIRE( parse_full(frame) == parse_full_dom(frame) );
+    };
+}
+
+TEST_CASE( "Full parser vs json document", "[!benchmark][Full]" ) {
+    std::vector<std::string> frames;
+    for (int i = 0; i < 1000; i++) {
+        frames.push_back(samples[i % samples.size()]);
+    };
+
+    BENCHMARK( "parse into reused Full" ) {
+        Full full;
+        std::int64_t sum = 0;
+        for (const auto& frame: frames) {
+            parse_full(frame, full);
+            sum += full.sequence;
+        };
+        return sum;
+    };
+
+    BENCHMARK( "parse json document" ) {
+        std::int64_t sum = 0;
+        for (const auto& frame: frames) {
+            sum += parse_full_dom(frame).sequence;
+        };
+        return sum;
+    };
+}
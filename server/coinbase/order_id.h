@@ -0,0 +1,13 @@
+#ifndef COINBASE_ORDER_ID_H
+#define COINBASE_ORDER_ID_H 1
+
+#include "../order_id.h"
+
+namespace coinbase {
+
+// order ids are parsed straight into binary keys used by orderbooks
+using OrderId = ::OrderId;
+
+}; // namespace coinbase
+
+#endif
\ No newline at end of file
@@ -1,28 +1,191 @@
 #include "orderbook.h"
 
-#include <boost/json.hpp>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#include <boost/json/basic_parser_impl.hpp>
 
 namespace coinbase {
 
-OrderBook parse_orderbook(std::string data) {
-    return value_to<OrderBook>(boost::json::parse(data));  
+// Handler receives events of json parser and keeps track of position in orderbook document:
+// depth 1 is the top level object, depth 2 bids or asks array and depth 3 entry array of price, size and order id.
+// Values of other keys are skipped.
+class OrderBookParser::Handler {
+public:
+    constexpr static std::size_t max_object_size = std::size_t(-1);
+    constexpr static std::size_t max_array_size = std::size_t(-1);
+    constexpr static std::size_t max_key_size = std::size_t(-1);
+    constexpr static std::size_t max_string_size = std::size_t(-1);
+
+    OrderBook orderbook{};
+    bool has_sequence = false;
+
+    bool on_document_begin(boost::json::error_code&) { return true; };
+    bool on_document_end(boost::json::error_code&) { return true; };
+
+    bool on_object_begin(boost::json::error_code&) {
+        depth++;
+        return true;
+    };
+
+    bool on_object_end(std::size_t, boost::json::error_code&) {
+        depth--;
+        return true;
+    };
+
+    bool on_array_begin(boost::json::error_code&) {
+        depth++;
+
+        if (depth == 2 && (key == "bids" || key == "asks")) {
+            entries = key == "bids" ? &orderbook.bids : &orderbook.asks;
+        } else if (depth == 3 && entries != nullptr) {
+            column = 0;
+        };
+
+        return true;
+    };
+
+    bool on_array_end(std::size_t, boost::json::error_code&) {
+        if (depth == 3 && entries != nullptr) {
+            if (column < 3) {
+                throw std::invalid_argument("incomplete orderbook entry");
+            };
+
+            entries->push_back(entry);
+        } else if (depth == 2) {
+            entries = nullptr;
+        };
+
+        depth--;
+        return true;
+    };
+
+    bool on_key_part(boost::json::string_view src, std::size_t, boost::json::error_code&) {
+        part.append(src.data(), src.size());
+        return true;
+    };
+
+    bool on_key(boost::json::string_view src, std::size_t, boost::json::error_code&) {
+        part.append(src.data(), src.size());
+
+        if (depth == 1) {
+            key.swap(part);
+        };
+
+        part.clear();
+        return true;
+    };
+
+    bool on_string_part(boost::json::string_view src, std::size_t, boost::json::error_code&) {
+        if (depth == 3 && entries != nullptr) {
+            part.append(src.data(), src.size());
+        };
+
+        return true;
+    };
+
+    bool on_string(boost::json::string_view src, std::size_t, boost::json::error_code&) {
+        if (depth != 3 || entries == nullptr) {
+            return true;
+        };
+
+        // value split across chunks is joined, otherwise it is decoded straight from the chunk
+        std::string_view value{src.data(), src.size()};
+        if (!part.empty()) {
+            part.append(src.data(), src.size());
+            value = part;
+        };
+
+        switch (column++) {
+        case 0:
+            entry.price = Decimal{value}; break;
+        case 1:
+            entry.size = Decimal{value}; break;
+        case 2:
+            entry.order_id = OrderId{value}; break;
+        };
+
+        part.clear();
+        return true;
+    };
+
+    bool on_number_part(boost::json::string_view, boost::json::error_code&) { return true; };
+
+    bool on_int64(std::int64_t value, boost::json::string_view, boost::json::error_code&) {
+        if (depth == 1 && key == "sequence") {
+            orderbook.sequence = value;
+            has_sequence = true;
+        };
+
+        return true;
+    };
+
+    bool on_uint64(std::uint64_t, boost::json::string_view, boost::json::error_code&) {
+        if (depth == 1 && key == "sequence") {
+            throw std::invalid_argument("sequence out of range");
+        };
+
+        return true;
+    };
+
+    bool on_double(double, boost::json::string_view, boost::json::error_code&) { return true; };
+    bool on_bool(bool, boost::json::error_code&) { return true; };
+    bool on_null(boost::json::error_code&) { return true; };
+    bool on_comment_part(boost::json::string_view, boost::json::error_code&) { return true; };
+    bool on_comment(boost::json::string_view, boost::json::error_code&) { return true; };
+
+private:
+    std::size_t depth = 0;
+    // the last key of top level object
+    std::string key;
+    // part of string or key split across chunks
+    std::string part;
+
+    std::vector<OrderBook::Entry>* entries = nullptr;
+    OrderBook::Entry entry{};
+    std::size_t column = 0;
 };
 
-OrderBook tag_invoke(boost::json::value_to_tag<OrderBook>, boost::json::value const& src) {
-    return OrderBook{
-        .sequence = src.at("sequence").as_int64(),
-        .bids = boost::json::value_to<std::vector<OrderBook::Entry>>(src.at("bids")),
-        .asks = boost::json::value_to<std::vector<OrderBook::Entry>>(src.at("asks"))
+class OrderBookParser::Impl {
+public:
+    boost::json::basic_parser<Handler> parser{boost::json::parse_options{}};
+};
+
+OrderBookParser::OrderBookParser(): impl(std::make_unique<Impl>()) {};
+
+OrderBookParser::~OrderBookParser() = default;
+
+void OrderBookParser::write(std::string_view chunk) {
+    boost::json::error_code ec;
+    impl->parser.write_some(true, chunk.data(), chunk.size(), ec);
+
+    if (ec) {
+        throw std::invalid_argument("malformed orderbook: " + ec.message());
     };
 };
 
-OrderBook::Entry tag_invoke(boost::json::value_to_tag<OrderBook::Entry>, boost::json::value const& src) {
-    auto arr = src.as_array();
-    return OrderBook::Entry{
-        .price = Decimal{boost::json::value_to<std::string>(arr.at(0))},
-        .size = Decimal{boost::json::value_to<std::string>(arr.at(1))},
-        .order_id = boost::json::value_to<std::string>(arr.at(2))
+OrderBook OrderBookParser::finish() {
+    boost::json::error_code ec;
+    impl->parser.write_some(false, "", 0, ec);
+
+    if (ec) {
+        throw std::invalid_argument("malformed orderbook: " + ec.message());
     };
+
+    auto& handler = impl->parser.handler();
+    if (!handler.has_sequence) {
+        throw std::invalid_argument("missing sequence in orderbook");
+    };
+
+    return std::move(handler.orderbook);
+};
+
+OrderBook parse_orderbook(std::string_view data) {
+    OrderBookParser parser;
+    parser.write(data);
+
+    return parser.finish();
 };
 
 std::ostream& operator<<(std::ostream& os, const OrderBook& v) {
@@ -1,11 +1,14 @@
 #ifndef COINBASE_ORDERBOOK_H
 #define COINBASE_ORDERBOOK_H 1
 
+#include <memory>
 #include <ostream>
 #include <vector>
 #include <string>
+#include <string_view>
 
 #include "decimal.h"
+#include "order_id.h"
 
 namespace coinbase {
 
@@ -14,7 +17,7 @@ struct OrderBook {
     struct Entry {
         Decimal price;
         Decimal size;
-        std::string order_id;
+        OrderId order_id;
 
         bool operator==(const Entry&) const = default;
     };
@@ -26,7 +29,29 @@ struct OrderBook {
     bool operator==(const OrderBook&) const = default;
 };
 
-OrderBook parse_orderbook(std::string data);
+// OrderBookParser decodes orderbook incrementally from chunks of http body as they arrive.
+// Entries are appended to orderbook as soon as they are complete, body is neither buffered nor parsed into json document.
+class OrderBookParser {
+public:
+    OrderBookParser();
+    ~OrderBookParser();
+
+    // write parses next chunk of body
+    // throws std::invalid_argument if body is malformed
+    void write(std::string_view chunk);
+
+    // finish returns orderbook once the whole body was written
+    // throws std::invalid_argument if body is incomplete
+    OrderBook finish();
+
+private:
+    class Handler;
+    class Impl;
+
+    std::unique_ptr<Impl> impl;
+};
+
+OrderBook parse_orderbook(std::string_view data);
 
 std::ostream& operator<<(std::ostream&, const OrderBook&);
 std::ostream& operator<<(std::ostream&, const OrderBook::Entry&);
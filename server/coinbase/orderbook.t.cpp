@@ -1,5 +1,8 @@
 #include "orderbook.h"
 
+#include <string>
+#include <string_view>
+
 #include <catch2/catch.hpp>
 
 using namespace coinbase;
@@ -27,3 +30,43 @@ TEST_CASE( "OrderBook is unmarshaled", "[orderbook]" ) {
     } );
 }
 
+
+TEST_CASE( "OrderBook is unmarshaled from chunks", "[orderbook]" ) {
+    std::string data = R"json({"sequence":352174631,"bids":[["36206.76","3009.99944762","92f09c53-5dc0-4985-9365-dc628b9d492c"],["36206.75","4771","6640aa13-c0e4-4a71-9848-3477c06d280d"]],"auction":{"bids":[["1","2","3"]]},"asks":[["36206.78","3009.99972423","20ab9c48-171e-4eea-bb22-5c486712a4b9"]]})json";
+    auto expected = OrderBook{
+        .sequence = 352174631,
+        .bids = {
+            {.price = Decimal{"36206.76"}, .size = Decimal{"3009.99944762"}, .order_id = "92f09c53-5dc0-4985-9365-dc628b9d492c"},
+            {.price = Decimal{"36206.75"}, .size = Decimal{"4771"}, .order_id = "6640aa13-c0e4-4a71-9848-3477c06d280d"},
+        },
+        .asks = {
+            {.price = Decimal{"36206.78"}, .size = Decimal{"3009.99972423"}, .order_id = "20ab9c48-171e-4eea-bb22-5c486712a4b9"},
+        }
+    };
+
+    SECTION( "split at any position" ) {
+        for (std::size_t pos = 0; pos <= data.size(); pos++) {
+            OrderBookParser parser;
+            parser.write(std::string_view{data}.substr(0, pos));
+            parser.write(std::string_view{data}.substr(pos));
+
+            REQUIRE( parser.finish() == expected );
+        };
+    }
+
+    SECTION( "byte by byte" ) {
+        OrderBookParser parser;
+        for (auto c: data) {
+            parser.write(std::string_view{&c, 1});
+        };
+
+        REQUIRE( parser.finish() == expected );
+    }
+
+    SECTION( "malformed" ) {
+        REQUIRE_THROWS_AS( parse_orderbook(data.substr(0, data.size() - 1)), std::invalid_argument );
+        REQUIRE_THROWS_AS( parse_orderbook(R"json({"bids":[],"asks":[]})json"), std::invalid_argument );
+        REQUIRE_THROWS_AS( parse_orderbook(R"json({"sequence":1,"bids":[["1","2"]],"asks":[]})json"), std::invalid_argument );
+        REQUIRE_THROWS_AS( parse_orderbook(R"json({"sequence":1,"bids":[["x","2","92f09c53-5dc0-4985-9365-dc628b9d492c"]],"asks":[]})json"), std::invalid_argument );
+    }
+}
@@ -0,0 +1,104 @@
+#include "conflator.h"
+
+#include <boost/range/adaptor/map.hpp>
+
+namespace {
+
+std::vector<OrderBook::Entry> take_entries(std::unordered_map<OrderId, OrderBook::Entry>& src) {
+    std::vector<OrderBook::Entry> dst;
+    dst.reserve(src.size());
+
+    for (auto& entry: src | boost::adaptors::map_values) {
+        dst.push_back(std::move(entry));
+    };
+
+    src.clear();
+
+    return dst;
+};
+
+} // anonymous namespace
+
+void Conflator::push(Message<OrderBook::Update> message) {
+    if (message->value().resync) {
+        _updates.clear();
+        _merged = false;
+        _bids.clear();
+        _asks.clear();
+        _stale.reset();
+        _resync = std::move(message);
+    } else if (message->value().stale) {
+        _stale = std::move(message);
+    } else if (!_merged && _updates.size() < _limit) {
+        _updates.push_back(std::move(message));
+    } else {
+        // stream fell behind, fold pending updates and all further ones into delta
+        for (const auto& pending: _updates) {
+            merge(pending->value());
+        };
+        _updates.clear();
+
+        merge(message->value());
+        _merged = true;
+    };
+};
+
+void Conflator::overflow() {
+    _overflowed = true;
+};
+
+void Conflator::merge(const OrderBook::Update& update) {
+    // update entries carry actual price and size so the latest one for order replaces earlier ones
+    if (update.bid) {
+        _bids.insert_or_assign(update.bid->order_id, *update.bid);
+    };
+
+    if (update.ask) {
+        _asks.insert_or_assign(update.ask->order_id, *update.ask);
+    };
+
+    _product_id = update.product_id;
+    _sequence = update.sequence;
+    _checksum = update.checksum;
+};
+
+PopResult<Conflator::Pending> Conflator::take() {
+    if (_overflowed) {
+        return {std::nullopt, PopState::overflow};
+    };
+
+    if (_resync) {
+        Updates updates{std::move(*_resync)};
+        _resync.reset();
+
+        return {std::move(updates), PopState::valid};
+    };
+
+    if (_merged) {
+        _merged = false;
+
+        return {Delta{
+            .product_id = _product_id,
+            .sequence = _sequence,
+            .bids = take_entries(_bids),
+            .asks = take_entries(_asks),
+            .checksum = _checksum,
+        }, PopState::valid};
+    };
+
+    if (_updates.empty() && _stale) {
+        Updates updates{std::move(*_stale)};
+        _stale.reset();
+
+        return {std::move(updates), PopState::valid};
+    };
+
+    if (_updates.empty()) {
+        return {std::nullopt, PopState::timeout};
+    };
+
+    Updates updates;
+    std::swap(updates, _updates);
+
+    return {std::move(updates), PopState::valid};
+};
@@ -0,0 +1,74 @@
+#ifndef CONFLATOR_H
+#define CONFLATOR_H 1
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "dispatcher.h"
+#include "orderbook.h"
+#include "ring_buffer.h"
+
+// Conflator buffers orderbook updates for stream that may not keep up with them.
+// Updates are passed through as they are until more than limit of them is pending,
+// then pending updates are merged per order id so that stream receives net delta instead.
+// Resync update discards pending updates, as they are replaced by snapshot that follows it.
+// Stale update is taken after pending updates that preceded it.
+// Conflator is owned by single stream, it is not synchronized.
+class Conflator {
+public:
+    // Delta is net change of orderbook entries up to sequence
+    // Removed entries have zero size.
+    struct Delta {
+        std::string product_id;
+        std::int64_t sequence;
+        std::vector<OrderBook::Entry> bids;
+        std::vector<OrderBook::Entry> asks;
+        // checksum of orderbook at sequence
+        std::uint64_t checksum;
+    };
+
+    using Updates = std::vector<Message<OrderBook::Update>>;
+    using Pending = std::variant<Updates, Delta>;
+
+    explicit Conflator(std::size_t limit): _limit(limit) {};
+
+    Conflator(const Conflator&) = delete;
+    Conflator& operator=(const Conflator&) = delete;
+
+    void push(Message<OrderBook::Update> message);
+
+    // overflow marks that updates were lost before they could be pushed
+    void overflow();
+
+    // take returns pending updates, or their delta if they were merged
+    // Returns State::overflow if updates were lost and State::timeout if nothing is pending.
+    PopResult<Pending> take();
+
+private:
+    const std::size_t _limit;
+
+    bool _overflowed = false;
+
+    Updates _updates;
+
+    // resync update that is taken before updates pushed after it
+    std::optional<Message<OrderBook::Update>> _resync;
+    // stale update that is taken once pending updates were taken
+    std::optional<Message<OrderBook::Update>> _stale;
+
+    // merged updates
+    bool _merged = false;
+    std::string _product_id;
+    std::int64_t _sequence = 0;
+    std::uint64_t _checksum = 0;
+    std::unordered_map<OrderId, OrderBook::Entry> _bids;
+    std::unordered_map<OrderId, OrderBook::Entry> _asks;
+
+    void merge(const OrderBook::Update& update);
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "conflator.h"
+
+#include <algorithm>
+
+#include <catch2/catch.hpp>
+
+namespace {
+    const OrderId a{0, 1}, b{0, 2}, c{0, 3};
+
+    Message<OrderBook::Update> make_update(std::int64_t sequence, OrderId order_id, const char* size) {
+        return std::make_shared<const Envelope<OrderBook::Update>>(OrderBook::Update{
+            .product_id = "BTC-USD",
+            .sequence = sequence,
+            .bid{{.order_id = order_id, .price = Decimal{"1.0"}, .size = Decimal{size}}},
+        });
+    };
+} // anonymous namespace
+
+TEST_CASE( "Conflator", "[conflator]" ) {
+    Conflator conflator{2};
+
+    SECTION( "updates within limit are passed through" ) {
+        auto u1 = make_update(1, a, "1.0");
+        auto u2 = make_update(2, b, "1.0");
+
+        conflator.push(u1);
+        conflator.push(u2);
+
+        auto [res, state] = conflator.take();
+
+        REQUIRE( state == PopState::valid );
+        REQUIRE( std::get<Conflator::Updates>(*res) == Conflator::Updates{u1, u2} );
+        REQUIRE( conflator.take().state == PopState::timeout );
+    }
+
+    SECTION( "updates over limit are merged per order" ) {
+        conflator.push(make_update(1, a, "1.0"));
+        conflator.push(make_update(2, b, "1.0"));
+        conflator.push(make_update(3, a, "0.5"));
+        conflator.push(make_update(4, b, "0"));
+
+        auto [res, state] = conflator.take();
+
+        REQUIRE( state == PopState::valid );
+
+        auto delta = std::get<Conflator::Delta>(*res);
+        std::sort(delta.bids.begin(), delta.bids.end(), [](const auto& lhs, const auto& rhs) { return lhs.order_id < rhs.order_id; });
+
+        REQUIRE( delta.product_id == "BTC-USD" );
+        REQUIRE( delta.sequence == 4 );
+        REQUIRE( delta.bids == std::vector<OrderBook::Entry>{
+            {.order_id = a, .price = Decimal{"1.0"}, .size = Decimal{"0.5"}},
+            {.order_id = b, .price = Decimal{"1.0"}, .size = Decimal{"0"}},
+        });
+        REQUIRE( delta.asks.empty() );
+
+        // updates are passed through again once delta was taken
+        auto u5 = make_update(5, c, "1.0");
+        conflator.push(u5);
+
+        REQUIRE( std::get<Conflator::Updates>(*conflator.take().value) == Conflator::Updates{u5} );
+    }
+
+    SECTION( "resync discards pending updates" ) {
+        conflator.push(make_update(1, a, "1.0"));
+        conflator.push(make_update(2, b, "1.0"));
+        conflator.push(make_update(3, a, "0.5"));
+
+        auto resync = std::make_shared<const Envelope<OrderBook::Update>>(OrderBook::Update{
+            .product_id = "BTC-USD",
+            .sequence = 5,
+            .resync = true,
+        });
+        conflator.push(resync);
+
+        auto u6 = make_update(6, c, "1.0");
+        conflator.push(u6);
+
+        // resync is taken alone before updates pushed after it
+        REQUIRE( std::get<Conflator::Updates>(*conflator.take().value) == Conflator::Updates{resync} );
+        REQUIRE( std::get<Conflator::Updates>(*conflator.take().value) == Conflator::Updates{u6} );
+        REQUIRE( conflator.take().state == PopState::timeout );
+    }
+
+    SECTION( "stale is taken after pending updates" ) {
+        auto u1 = make_update(1, a, "1.0");
+        conflator.push(u1);
+
+        auto stale = std::make_shared<const Envelope<OrderBook::Update>>(OrderBook::Update{
+            .product_id = "BTC-USD",
+            .sequence = 1,
+            .stale = true,
+        });
+        conflator.push(stale);
+
+        REQUIRE( std::get<Conflator::Updates>(*conflator.take().value) == Conflator::Updates{u1} );
+        REQUIRE( std::get<Conflator::Updates>(*conflator.take().value) == Conflator::Updates{stale} );
+        REQUIRE( conflator.take().state == PopState::timeout );
+    }
+
+    SECTION( "overflow" ) {
+        conflator.push(make_update(1, a, "1.0"));
+        conflator.overflow();
+
+        REQUIRE( conflator.take().state == PopState::overflow );
+    }
+}
@@ -0,0 +1,196 @@
+#include "decimal.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// digits_end returns end of run of decimal digits starting at begin
+const char* digits_end(const char* begin, const char* end) {
+    while (begin < end && *begin >= '0' && *begin <= '9') {
+        begin++;
+    };
+
+    return begin;
+};
+
+// eight_digits converts 8 ascii digits at once, adjacent digits are combined into pairs, quads and octet
+std::uint64_t eight_digits(const char* src) {
+    std::uint64_t v;
+    std::memcpy(&v, src, sizeof(v));
+
+    v = (v & 0x0f0f0f0f0f0f0f0full) * 2561 >> 8;
+    v = (v & 0x00ff00ff00ff00ffull) * 6553601 >> 16;
+    return (v & 0x0000ffff0000ffffull) * 42949672960001ull >> 32;
+};
+
+// parse_fast converts decimals with at most 10 integral digits, which cannot overflow even when rounded, without per-digit checks.
+// Returns false if src has to be parsed by the checked loop which also reports errors.
+bool parse_fast(std::string_view src, std::int64_t& units) {
+    if constexpr (std::endian::native != std::endian::little) {
+        return false;
+    };
+
+    auto it = src.data();
+    auto end = it + src.size();
+
+    bool negative = it != end && *it == '-';
+    if (it != end && (*it == '-' || *it == '+')) {
+        it++;
+    };
+
+    auto integral_end = digits_end(it, end);
+    auto integral = integral_end - it;
+
+    auto fractional_begin = integral_end;
+    if (fractional_begin != end && *fractional_begin == '.') {
+        fractional_begin++;
+    };
+
+    auto fractional_end = digits_end(fractional_begin, end);
+    auto fractional = fractional_end - fractional_begin;
+
+    if (fractional_end != end || integral + fractional == 0 || integral > 10) {
+        return false;
+    };
+
+    // digits past precision round the value half away from zero
+    bool round = fractional > Decimal::digits && fractional_begin[Decimal::digits] >= '5';
+    fractional = std::min<std::ptrdiff_t>(fractional, Decimal::digits);
+
+    // leading integral digits over 8 are accumulated one by one
+    std::int64_t value = 0;
+    auto head = std::max<std::ptrdiff_t>(integral - 8, 0);
+    for (auto digit = it; digit < it + head; digit++) {
+        value = value * 10 + (*digit - '0');
+    };
+
+    // the rest of integral digits is right aligned in zero padded buffer and fractional digits are left aligned,
+    // so that fractional value comes out already scaled to units
+    char buf[16];
+    std::memset(buf, '0', sizeof(buf));
+    std::memcpy(buf + 8 - (integral - head), it + head, integral - head);
+    std::memcpy(buf + 8, fractional_begin, fractional);
+
+    value = (value * 100000000 + eight_digits(buf)) * Decimal::scale + eight_digits(buf + 8) + round;
+    units = negative ? -value : value;
+
+    return true;
+};
+
+} // anonymous namespace
+
+Decimal::Decimal(std::string_view src) {
+    if (parse_fast(src, _units)) {
+        return;
+    };
+
+    auto it = src.begin();
+    auto end = src.end();
+
+    bool negative = false;
+    if (it != end && (*it == '-' || *it == '+')) {
+        negative = *it == '-';
+        it++;
+    };
+
+    // accumulate as negative value so that minimum is representable
+    constexpr auto min = std::numeric_limits<std::int64_t>::min();
+
+    std::int64_t units = 0;
+    int integral = 0, fractional = 0;
+    bool point = false;
+    // the first digit past precision, value is rounded half away from zero
+    char round = '0';
+    bool past = false;
+
+    for (; it != end; it++) {
+        if (*it == '.' && !point) {
+            point = true;
+            continue;
+        };
+
+        if (*it < '0' || *it > '9') {
+            throw std::invalid_argument("invalid decimal");
+        };
+
+        // digits past precision are only validated
+        if (point && fractional == digits) {
+            round = past ? round : *it;
+            past = true;
+            continue;
+        };
+
+        fractional += point;
+        integral += !point;
+
+        if (units < (min + (*it - '0')) / 10) {
+            throw std::out_of_range("decimal out of range");
+        };
+
+        units = units * 10 - (*it - '0');
+    };
+
+    if (integral + fractional == 0) {
+        throw std::invalid_argument("invalid decimal");
+    };
+
+    for (; fractional < digits; fractional++) {
+        if (units < min / 10) {
+            throw std::out_of_range("decimal out of range");
+        };
+
+        units *= 10;
+    };
+
+    if (round >= '5') {
+        if (units == min) {
+            throw std::out_of_range("decimal out of range");
+        };
+
+        units--;
+    };
+
+    if (!negative && units == min) {
+        throw std::out_of_range("decimal out of range");
+    };
+
+    _units = negative ? units : -units;
+};
+
+std::string Decimal::str() const {
+    // format magnitude as unsigned so that minimum value does not overflow
+    auto magnitude = _units < 0 ? -static_cast<std::uint64_t>(_units) : static_cast<std::uint64_t>(_units);
+
+    auto integral = magnitude / scale;
+    auto fractional = magnitude % scale;
+
+    auto dst = (_units < 0 ? "-" : "") + std::to_string(integral);
+
+    if (fractional != 0) {
+        char buf[digits];
+        int n = digits;
+
+        for (int i = digits - 1; i >= 0; i--) {
+            buf[i] = '0' + fractional % 10;
+            fractional /= 10;
+        };
+
+        // drop trailing zeros
+        while (buf[n - 1] == '0') {
+            n--;
+        };
+
+        dst.push_back('.');
+        dst.append(buf, n);
+    };
+
+    return dst;
+};
+
+std::ostream& operator<<(std::ostream& os, const Decimal& v) {
+    return os << v.str();
+};
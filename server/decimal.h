@@ -1,9 +1,56 @@
 #ifndef DECIMAL_H
 #define DECIMAL_H 1
 
-#include <boost/json.hpp>
-#include <boost/multiprecision/cpp_dec_float.hpp>
+#include <compare>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
 
-using Decimal = boost::multiprecision::number<boost::multiprecision::cpp_dec_float<8>>;
+// Decimal is fixed-point number stored as integer count of 1e-8 units.
+// Scale covers all Coinbase price and size increments so values are parsed and formatted exactly.
+// Arithmetic and comparison are plain integer operations.
+class Decimal {
+public:
+    static constexpr int digits = 8;
+    static constexpr std::int64_t scale = 100000000;
 
-#endif
\ No newline at end of file
+    constexpr Decimal() = default;
+
+    // parse decimal string ie. "-36206.76"
+    // Fractional digits past 1e-8 are rounded half away from zero, ie. funds "3000.234192254" to 3000.23419225.
+    // throws std::invalid_argument if value is malformed and std::out_of_range if it does not fit into units
+    explicit Decimal(std::string_view src);
+    explicit Decimal(const std::string& src): Decimal(std::string_view{src}) {};
+    explicit Decimal(const char* src): Decimal(std::string_view{src}) {};
+
+    static constexpr Decimal from_units(std::int64_t units) { Decimal dst; dst._units = units; return dst; };
+
+    // units returns value as integer count of 1e-8
+    constexpr std::int64_t units() const { return _units; };
+
+    constexpr bool is_zero() const { return _units == 0; };
+    constexpr int sign() const { return (_units > 0) - (_units < 0); };
+
+    // str formats value without trailing fractional zeros ie. "2.5", "3"
+    std::string str() const;
+
+    constexpr explicit operator bool() const { return _units != 0; };
+
+    constexpr Decimal operator-() const { return from_units(-_units); };
+
+    constexpr Decimal& operator+=(const Decimal& rhs) { _units += rhs._units; return *this; };
+    constexpr Decimal& operator-=(const Decimal& rhs) { _units -= rhs._units; return *this; };
+
+    friend constexpr Decimal operator+(Decimal lhs, const Decimal& rhs) { return lhs += rhs; };
+    friend constexpr Decimal operator-(Decimal lhs, const Decimal& rhs) { return lhs -= rhs; };
+
+    constexpr auto operator<=>(const Decimal&) const = default;
+
+private:
+    std::int64_t _units = 0;
+};
+
+std::ostream& operator<<(std::ostream& os, const Decimal& v);
+
+#endif
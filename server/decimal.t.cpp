@@ -0,0 +1,149 @@
+#include "decimal.h"
+
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/multiprecision/cpp_dec_float.hpp>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE( "Decimal is parsed and formatted exactly", "[decimal]" ) {
+    REQUIRE( Decimal{"36206.76"}.units() == 3620676000000 );
+    REQUIRE( Decimal{"0.00000001"}.units() == 1 );
+    REQUIRE( Decimal{"-0.5"}.units() == -50000000 );
+    REQUIRE( Decimal{"1."}.units() == Decimal::scale );
+    REQUIRE( Decimal{".5"}.units() == Decimal::scale / 2 );
+
+    REQUIRE( Decimal{"36206.76"}.str() == "36206.76" );
+    REQUIRE( Decimal{"3009.99944762"}.str() == "3009.99944762" );
+    REQUIRE( Decimal{"2.00"}.str() == "2" );
+    REQUIRE( Decimal{"-0.5"}.str() == "-0.5" );
+    REQUIRE( Decimal{"0"}.str() == "0" );
+
+    // market order funds carry more digits than precision
+    REQUIRE( Decimal{"3000.234192254"}.str() == "3000.23419225" );
+    REQUIRE( Decimal{"10.000000000000"}.units() == 10 * Decimal::scale );
+    REQUIRE( Decimal{"0.000000005"}.units() == 1 );
+    REQUIRE( Decimal{"0.0000000049999"}.units() == 0 );
+    REQUIRE( Decimal{"-0.123456785"}.units() == -12345679 );
+    REQUIRE( Decimal{"92233720368.547758074"}.units() == std::numeric_limits<std::int64_t>::max() );
+    REQUIRE_THROWS_AS( Decimal{"92233720368.547758075"}, std::out_of_range );
+    REQUIRE_THROWS_AS( Decimal{"-92233720368.547758085"}, std::out_of_range );
+    REQUIRE_THROWS_AS( Decimal{"1.0000000001x"}, std::invalid_argument );
+    REQUIRE( Decimal::from_units(std::numeric_limits<std::int64_t>::min()).str() == "-92233720368.54775808" );
+
+    REQUIRE_THROWS_AS( Decimal{""}, std::invalid_argument );
+    REQUIRE_THROWS_AS( Decimal{"-"}, std::invalid_argument );
+    REQUIRE_THROWS_AS( Decimal{"1.2.3"}, std::invalid_argument );
+    REQUIRE_THROWS_AS( Decimal{"1e5"}, std::invalid_argument );
+    REQUIRE_THROWS_AS( Decimal{"0.00000000x"}, std::invalid_argument );
+    REQUIRE_THROWS_AS( Decimal{"92233720368.54775808"}, std::out_of_range );
+    REQUIRE_THROWS_AS( Decimal{"1000000000000"}, std::out_of_range );
+}
+
+TEST_CASE( "Decimal is parsed exactly around digit chunks", "[decimal]" ) {
+    // values up to 10 integral digits are converted 8 digits at once, longer ones digit by digit
+    REQUIRE( Decimal{"12345678.87654321"}.units() == 1234567887654321 );
+    REQUIRE( Decimal{"123456789.1"}.units() == 12345678910000000 );
+    REQUIRE( Decimal{"9999999999.99999999"}.units() == 999999999999999999 );
+    REQUIRE( Decimal{"-9999999999.99999999"}.units() == -999999999999999999 );
+    REQUIRE( Decimal{"10000000000.00000001"}.units() == 1000000000000000001 );
+    REQUIRE( Decimal{"92233720368.54775807"}.units() == std::numeric_limits<std::int64_t>::max() );
+    REQUIRE( Decimal{"-92233720368.54775808"}.units() == std::numeric_limits<std::int64_t>::min() );
+    REQUIRE( Decimal{"+0012.50"}.units() == 1250000000 );
+    REQUIRE( Decimal{"0.00000000"}.units() == 0 );
+
+    for (std::int64_t units = 1; units < 100000000000000000; units = units * 7 + 3) {
+        REQUIRE( Decimal{Decimal::from_units(units).str()}.units() == units );
+        REQUIRE( Decimal{Decimal::from_units(-units).str()}.units() == -units );
+    };
+
+    REQUIRE_THROWS_AS( Decimal{"12345678.9x"}, std::invalid_argument );
+    REQUIRE_THROWS_AS( Decimal{"1.123456789x"}, std::invalid_argument );
+    // digits past precision are rounded by both paths
+    REQUIRE( Decimal{"1.123456789"}.units() == 112345679 );
+    REQUIRE( Decimal{"1.123456784999"}.units() == 112345678 );
+    REQUIRE( Decimal{"-1.123456785"}.units() == -112345679 );
+    REQUIRE( Decimal{"9999999999.999999995"}.units() == 1000000000000000000 );
+    REQUIRE( Decimal{"10000000000.000000005"}.units() == 1000000000000000001 );
+    REQUIRE( Decimal{"3000.234192254"}.units() == Decimal{"3000.23419225"}.units() );
+    REQUIRE_THROWS_AS( Decimal{"+"}, std::invalid_argument );
+    REQUIRE_THROWS_AS( Decimal{"."}, std::invalid_argument );
+}
+
+TEST_CASE( "Decimal arithmetic", "[decimal]" ) {
+    auto size = Decimal{"1.5"};
+
+    REQUIRE( size + -Decimal{"0.5"} == Decimal{"1"} );
+    REQUIRE( (size - Decimal{"1.5"}).is_zero() );
+    REQUIRE( (Decimal{"0.1"} - size).sign() == -1 );
+    REQUIRE( Decimal{"2.1"} > Decimal{"2.09999999"} );
+    REQUIRE( !Decimal{} );
+}
+
+TEST_CASE( "Decimal vs cpp_dec_float", "[!benchmark][decimal]" ) {
+    using Float = boost::multiprecision::number<boost::multiprecision::cpp_dec_float<8>>;
+
+    std::vector<std::string> prices;
+    for (int i = 0; i < 1000; i++) {
+        prices.push_back(std::to_string(36000 + i * 7 % 1000) + "." + std::to_string(i % 100));
+    };
+
+    BENCHMARK( "parse (fixed-point)" ) {
+        Decimal sum;
+        for (const auto& price: prices) {
+            sum += Decimal{price};
+        };
+        return sum;
+    };
+
+    BENCHMARK( "parse (cpp_dec_float)" ) {
+        Float sum;
+        for (const auto& price: prices) {
+            sum += Float{price};
+        };
+        return sum;
+    };
+
+    std::multimap<Decimal, int> fixed;
+    std::multimap<Float, int> floating;
+    for (const auto& price: prices) {
+        fixed.emplace(Decimal{price}, 0);
+        floating.emplace(Float{price}, 0);
+    };
+
+    BENCHMARK( "lookup and update (fixed-point)" ) {
+        Decimal size;
+        for (const auto& [price, _]: fixed) {
+            size = size + fixed.find(price)->first - Decimal{"0.00000001"};
+        };
+        return size;
+    };
+
+    BENCHMARK( "lookup and update (cpp_dec_float)" ) {
+        Float size;
+        for (const auto& [price, _]: floating) {
+            size = size + floating.find(price)->first - Float{"0.00000001"};
+        };
+        return size;
+    };
+
+    BENCHMARK( "format (fixed-point)" ) {
+        std::size_t n = 0;
+        for (const auto& [price, _]: fixed) {
+            n += price.str().size();
+        };
+        return n;
+    };
+
+    BENCHMARK( "format (cpp_dec_float)" ) {
+        std::size_t n = 0;
+        for (const auto& [price, _]: floating) {
+            n += price.str().size();
+        };
+        return n;
+    };
+}
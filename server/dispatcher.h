@@ -1,92 +1,339 @@
 #ifndef DISPATCHER_H
 #define DISPATCHER_H 1
 
+#include <algorithm>
+#include <any>
+#include <atomic>
 #include <condition_variable>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
-#include <set>
-#include <tuple>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "broadcast_ring.h"
 #include "ring_buffer.h"
+#include "wait.h"
 
+// Envelope holds immutable value shared by all subscribers.
+// Encoding of the value (ie. wire format) is computed once and reused by all subscribers.
 template<typename T>
-class Subscriber;
+class Envelope {
+public:
+    explicit Envelope(T&& value): _value(std::move(value)) {};
+
+    inline const T& value() const { return _value; };
+
+    // encode returns value encoded with encoder, encoder is invoked only for the first call
+    // All calls for given value type are expected to use the same encoding type E,
+    // throws std::bad_any_cast if value was already encoded into another type.
+    template<typename E, typename F> const E& encode(F&& encoder) const;
+
+private:
+    const T _value;
+    mutable std::once_flag _once;
+    mutable std::any _encoded;
+};
+
+template<typename T>
+using Message = std::shared_ptr<const Envelope<T>>;
 
 template<typename T>
+class Subscriber;
+
+template<typename T, typename Key = std::string>
 class Dispatcher {
 public:
-    Dispatcher(std::size_t size): size(size) { };
+    // Values are routed to keyed subscribers by member pointed by key (ie. product id).
+    Dispatcher(std::size_t size, Key T::* key, WaitStrategy wait = {});
+
+    Dispatcher(const Dispatcher&) = delete;
+    Dispatcher& operator=(const Dispatcher&) = delete;
 
-    // Subscribe creates subscriber that dispatcher will forward values to.
-    // When subscriber is destroyed then associated buffer is removed.
+    // Subscribe creates subscriber that dispatcher will forward values with given key to.
+    // Subscribers with the same key share single ring, each subscriber only keeps its read cursor.
+    // Subscriber starts with up to replay values that are still retained by the ring, the newest ones.
+    std::shared_ptr<Subscriber<T>> subscribe(const Key& key, std::size_t replay = 0);
+
+    // Subscribe creates subscriber that dispatcher will forward values accepted by filter to.
+    // Filtered subscribers read all dispatched values, keyed subscription should be preferred.
     std::shared_ptr<Subscriber<T>> subscribe(std::function<bool(const T&)> filter = [](const auto&) { return true; });
 
-    // Dispatch forwards values to all subscribers.
-    // If subscriber was destroyed or has overflowed then associated buffer will be removed.
-    void dispatch(const T& value);
+    // Dispatch publishes value to ring of its key and ring of filtered subscribers.
+    // Value is allocated once and shared by all subscribers.
+    // Subscribers that were lapped by dispatcher have overflowed.
+    // Dispatch never waits for the lock, rings are looked up in the current registry snapshot.
+    // Dispatch that finds rings left without subscribers or snapshots no longer read prunes and releases them if the lock is free.
+    // Values of different keys may be dispatched concurrently, values of one key must be dispatched from single thread.
+    void dispatch(Message<T> message);
+    void dispatch(T&& value) { dispatch(std::make_shared<const Envelope<T>>(std::move(value))); };
 
 private:
-    std::mutex mtx;
+    using Ring = BroadcastRing<Message<T>>;
+
+    // Subscription is shared by subscribers of ring, dispatcher is flagged to prune the ring once the last of them is gone.
+    struct Subscription {
+        std::shared_ptr<Ring> ring;
+        std::shared_ptr<std::atomic<bool>> unsubscribed;
+
+        ~Subscription() { unsubscribed->store(true, std::memory_order_release); };
+    };
+
+    // Slot is ring of registry, subscribers expires once the ring has no subscribers.
+    struct Slot {
+        std::shared_ptr<Ring> ring;
+        std::weak_ptr<Ring> subscribers;
+    };
+
+    // Registry is immutable snapshot of rings, subscriptions that need new ring publish new snapshot.
+    struct Registry {
+        std::unordered_map<Key, Slot> keyed;
+        Slot filtered;
+    };
+
     std::size_t size;
-    // NOTE: std::set is used instead of std::unordered_set due to the fact that weak_ptr cannot be hashed
-    std::set<std::weak_ptr<Subscriber<T>>, std::owner_less<std::weak_ptr<Subscriber<T>>>> subscribers;
+    Key T::* key_member;
+    WaitStrategy wait;
+
+    // guards publishing of snapshots
+    std::mutex mtx;
+    std::unique_ptr<const Registry> current;
+    // snapshots replaced while dispatch may still be reading them
+    std::vector<std::unique_ptr<const Registry>> retired;
+    // set while there are retired snapshots, the last dispatch in progress releases them
+    std::atomic<bool> retiring{false};
+    // set by subscription that lost its last subscriber, shared so that subscribers may outlive dispatcher
+    std::shared_ptr<std::atomic<bool>> unsubscribed = std::make_shared<std::atomic<bool>>(false);
+
+    alignas(cache_line_size) std::atomic<const Registry*> registry;
+    // number of dispatches in progress, retired snapshots are released once it drops to zero
+    std::atomic<std::size_t> readers{0};
+
+    // ring of filtered subscribers is written by dispatches of all keys
+    alignas(cache_line_size) std::mutex filtered_mtx;
+
+    // subscribe returns ring of new subscription, its subscribers share it
+    std::shared_ptr<Ring> subscribe(std::shared_ptr<Ring> ring);
+
+    // publish replaces current snapshot with its copy modified by mutate, must be called with mtx held
+    // Rings without subscribers are pruned from the copy.
+    template<typename F> void publish(F&& mutate);
+
+    // release releases retired snapshots if no dispatch is in progress, must be called with mtx held
+    void release();
+
+    // maintain prunes rings without subscribers and releases retired snapshots unless the lock is held
+    void maintain();
 };
 
 
 template<typename T>
 class Subscriber {
 public:
-    bool push(const T& value);
-    template<typename Rep> PopResult<T> pop(std::chrono::duration<Rep> timeout);
+    template<typename Rep, typename Period> PopResult<Message<T>> pop(std::chrono::duration<Rep, Period> timeout);
+
+    // drain appends up to max_n available messages to out, waiting for at least one message
+    template<typename Rep, typename Period> PopState drain(std::vector<Message<T>>& out, std::size_t max_n, std::chrono::duration<Rep, Period> timeout);
+
+    // watch arms watch to be invoked once the next message is dispatched, so that consumer does not block waiting for it
+    // Returns false without arming watch if message is already available.
+    bool watch(Signal::Watch& watch) { return ring->watch(cursor, watch); };
 
 private:
-    friend class Dispatcher<T>;
+    template<typename, typename> friend class Dispatcher;
+
+    using Ring = BroadcastRing<Message<T>>;
 
-    Subscriber(Dispatcher<T>& dispatcher, std::size_t size, std::function<bool(const T&)> filter) noexcept: dispatcher(dispatcher), buffer(size), filter(filter) {};
+    Subscriber(std::shared_ptr<Ring> ring, std::function<bool(const T&)> filter, std::size_t replay = 0) noexcept: ring(ring), cursor(ring->position()), filter(filter) {
+        cursor -= std::min(cursor, replay);
+    };
 
-    Dispatcher<T>& dispatcher;
-    RingBuffer<T> buffer;
+    std::shared_ptr<Ring> ring;
+    std::size_t cursor;
     std::function<bool(const T&)> filter;
 };
 
 template<typename T>
-std::shared_ptr<Subscriber<T>> Dispatcher<T>::subscribe(std::function<bool(const T&)> filter) {
+template<typename E, typename F>
+const E& Envelope<T>::encode(F&& encoder) const {
+    std::call_once(_once, [&] { _encoded.emplace<E>(encoder(_value)); });
+
+    return std::any_cast<const E&>(_encoded);
+};
+
+template<typename T, typename Key>
+Dispatcher<T, Key>::Dispatcher(std::size_t size, Key T::* key, WaitStrategy wait): size(size), key_member(key), wait(wait), current(std::make_unique<const Registry>()), registry(current.get()) {
+
+};
+
+template<typename T, typename Key>
+std::shared_ptr<Subscriber<T>> Dispatcher<T, Key>::subscribe(const Key& key, std::size_t replay) {
     std::unique_lock<std::mutex> lock(mtx);
 
-    auto subscriber = std::shared_ptr<Subscriber<T>>(new Subscriber<T>{*this, size, filter});
-    subscribers.insert(subscriber);
+    auto it = current->keyed.find(key);
+    if (it != current->keyed.end()) {
+        if (auto ring = it->second.subscribers.lock()) {
+            return std::shared_ptr<Subscriber<T>>(new Subscriber<T>{ring, nullptr, std::min(replay, size)});
+        }
+    }
 
-    return subscriber;
+    // ring that lost its subscribers is reused until it is pruned, so that its values can still be replayed
+    auto ring = it != current->keyed.end() ? it->second.ring : std::make_shared<Ring>(size, wait);
+    auto subscribed = subscribe(ring);
+    publish([&](auto& next) { next.keyed.insert_or_assign(key, Slot{ring, subscribed}); });
+
+    return std::shared_ptr<Subscriber<T>>(new Subscriber<T>{subscribed, nullptr, std::min(replay, size)});
 }
 
-template<typename T> 
-void Dispatcher<T>::dispatch(const T& value) {
+template<typename T, typename Key>
+std::shared_ptr<Subscriber<T>> Dispatcher<T, Key>::subscribe(std::function<bool(const T&)> filter) {
     std::unique_lock<std::mutex> lock(mtx);
-   
-    // push message to subscribers, removing those that are expired or overflowed
-    for (auto it = subscribers.cbegin(); it != subscribers.cend();) {
-        auto subscriber = it->lock();
-        if (!subscriber || !subscriber->push(value)) {
-            it = subscribers.erase(it);
-        } else {
-            it++;
+
+    if (auto ring = current->filtered.subscribers.lock()) {
+        return std::shared_ptr<Subscriber<T>>(new Subscriber<T>{ring, filter});
+    }
+
+    auto ring = std::make_shared<Ring>(size, wait);
+    auto subscribed = subscribe(ring);
+    publish([&](auto& next) { next.filtered = Slot{ring, subscribed}; });
+
+    return std::shared_ptr<Subscriber<T>>(new Subscriber<T>{subscribed, filter});
+}
+
+template<typename T, typename Key>
+std::shared_ptr<typename Dispatcher<T, Key>::Ring> Dispatcher<T, Key>::subscribe(std::shared_ptr<Ring> ring) {
+    auto subscription = std::make_shared<Subscription>(ring, unsubscribed);
+
+    // subscribers own ring through subscription, slot observes the subscription to tell whether any of them is left
+    return std::shared_ptr<Ring>(subscription, ring.get());
+}
+
+template<typename T, typename Key>
+template<typename F>
+void Dispatcher<T, Key>::publish(F&& mutate) {
+    release();
+
+    // flag is cleared before pruning, subscription that is lost meanwhile sets it again
+    unsubscribed->exchange(false, std::memory_order_acq_rel);
+
+    // prune rings whose subscribers are gone
+    auto subscribed = [](const auto& slot) {
+        return slot.ring && !slot.subscribers.expired();
+    };
+
+    auto next = std::make_unique<Registry>();
+    for (const auto& [key, slot]: current->keyed) {
+        if (subscribed(slot)) {
+            next->keyed.emplace(key, slot);
         }
     }
+
+    if (subscribed(current->filtered)) {
+        next->filtered = current->filtered;
+    }
+
+    mutate(*next);
+
+    // dispatches that start from now on observe new snapshot
+    registry.store(next.get(), std::memory_order_seq_cst);
+    retired.push_back(std::move(current));
+    retiring.store(true, std::memory_order_relaxed);
+    current = std::move(next);
+}
+
+template<typename T, typename Key>
+void Dispatcher<T, Key>::release() {
+    // dispatches that start after snapshot was replaced do not read it
+    if (readers.load(std::memory_order_seq_cst) == 0) {
+        retired.clear();
+        retiring.store(false, std::memory_order_relaxed);
+    }
+}
+
+template<typename T, typename Key>
+void Dispatcher<T, Key>::maintain() {
+    std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+    if (!lock) {
+        return;
+    }
+
+    if (unsubscribed->load(std::memory_order_acquire)) {
+        publish([](auto&) {});
+    } else {
+        release();
+    }
+}
+
+template<typename T, typename Key>
+void Dispatcher<T, Key>::dispatch(Message<T> message) {
+    readers.fetch_add(1, std::memory_order_seq_cst);
+    auto snapshot = registry.load(std::memory_order_seq_cst);
+
+    // rings are created on first subscription, values without subscribers are dropped
+    auto it = snapshot->keyed.find(message->value().*key_member);
+    if (it != snapshot->keyed.end()) {
+        it->second.ring->publish(message);
+    }
+
+    if (snapshot->filtered.ring) {
+        std::unique_lock<std::mutex> lock(filtered_mtx);
+        snapshot->filtered.ring->publish(std::move(message));
+    }
+
+    // snapshot must not be read once dispatch is no longer counted
+    auto remaining = readers.fetch_sub(1, std::memory_order_seq_cst) - 1;
+
+    if (unsubscribed->load(std::memory_order_relaxed) || (remaining == 0 && retiring.load(std::memory_order_relaxed))) {
+        maintain();
+    }
 };
 
 template<typename T>
-bool Subscriber<T>::push(const T& value) {
-    if (!filter(value)) {
-        return true;
-    };
+template<typename Rep, typename Period>
+PopResult<Message<T>> Subscriber<T>::pop(std::chrono::duration<Rep, Period> timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
 
-    return buffer.push(value);
-}
+    while (true) {
+        auto res = ring->read(cursor, deadline);
+        if (res.state != PopState::valid) {
+            return res;
+        }
 
-template<typename T> 
-template<typename Rep> 
-PopResult<T> Subscriber<T>::pop(std::chrono::duration<Rep> timeout) {
-    return buffer.pop_wait(timeout);
+        cursor++;
+
+        if (!filter || filter((*res.value)->value())) {
+            return res;
+        }
+    }
+};
+
+template<typename T>
+template<typename Rep, typename Period>
+PopState Subscriber<T>::drain(std::vector<Message<T>>& out, std::size_t max_n, std::chrono::duration<Rep, Period> timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    auto offset = out.size();
+
+    while (true) {
+        auto state = ring->read(cursor, out, max_n, deadline);
+        if (state != PopState::valid) {
+            return state;
+        }
+
+        cursor += out.size() - offset;
+
+        if (filter) {
+            auto it = std::remove_if(out.begin() + offset, out.end(), [this](const auto& message) {
+                return !filter(message->value());
+            });
+            out.erase(it, out.end());
+        }
+
+        if (out.size() > offset) {
+            return state;
+        }
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
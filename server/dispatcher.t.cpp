@@ -0,0 +1,246 @@
+#include "dispatcher.h"
+
+#include <atomic>
+#include <future>
+#include <thread>
+
+#include <catch2/catch.hpp>
+
+namespace {
+    struct Value {
+        std::string product_id;
+        int number;
+    };
+
+    int pop_value(Subscriber<Value>& subscriber) {
+        auto [res, state] = subscriber.pop(std::chrono::milliseconds(1));
+        return state == PopState::valid ? (*res)->value().number : -1;
+    };
+} // anonymous namespace
+
+TEST_CASE( "Dispatcher routes values", "[dispatcher]" ) {
+    Dispatcher<Value> dispatcher{16, &Value::product_id};
+
+    auto btc = dispatcher.subscribe(std::string{"BTC-USD"});
+    auto eth = dispatcher.subscribe(std::string{"ETH-USD"});
+    auto odd = dispatcher.subscribe([](const auto& msg) { return msg.number % 2 == 1; });
+
+    dispatcher.dispatch({.product_id = "BTC-USD", .number = 1});
+    dispatcher.dispatch({.product_id = "ETH-USD", .number = 2});
+
+    auto timeout = std::chrono::milliseconds(1);
+
+    SECTION( "keyed subscribers receive values with matching key" ) {
+        REQUIRE( pop_value(*btc) == 1 );
+        REQUIRE( btc->pop(timeout).state == PopState::timeout );
+
+        REQUIRE( pop_value(*eth) == 2 );
+        REQUIRE( eth->pop(timeout).state == PopState::timeout );
+    }
+
+    SECTION( "filtered subscribers receive accepted values" ) {
+        REQUIRE( pop_value(*odd) == 1 );
+        REQUIRE( odd->pop(timeout).state == PopState::timeout );
+    }
+
+    SECTION( "drain skips values rejected by filter" ) {
+        dispatcher.dispatch({.product_id = "BTC-USD", .number = 3});
+
+        std::vector<Message<Value>> out;
+
+        REQUIRE( odd->drain(out, 8, timeout) == PopState::valid );
+        REQUIRE( out.size() == 2 );
+        REQUIRE( out[0]->value().number == 1 );
+        REQUIRE( out[1]->value().number == 3 );
+    }
+
+    SECTION( "subscribers share dispatched value" ) {
+        auto all = dispatcher.subscribe();
+
+        dispatcher.dispatch({.product_id = "BTC-USD", .number = 3});
+
+        REQUIRE( pop_value(*btc) == 1 );
+
+        auto r1 = btc->pop(timeout).value;
+        auto r2 = all->pop(timeout).value;
+
+        REQUIRE( (*r1)->value().number == 3 );
+        REQUIRE( *r1 == *r2 );
+    }
+
+    SECTION( "subscribers share encoded value" ) {
+        auto res = btc->pop(timeout).value;
+
+        int calls = 0;
+        auto encoder = [&calls](const auto& value) {
+            calls++;
+            return std::to_string(value.number);
+        };
+
+        const auto& e1 = (*res)->encode<std::string>(encoder);
+        const auto& e2 = (*res)->encode<std::string>(encoder);
+
+        REQUIRE( e1 == "1" );
+        REQUIRE( &e1 == &e2 );
+        REQUIRE( calls == 1 );
+
+        // value is encoded once, so other encoding type is rejected
+        REQUIRE_THROWS_AS( (*res)->encode<int>([](const auto& value) { return value.number; }), std::bad_any_cast );
+    }
+
+    SECTION( "lapped subscribers overflow" ) {
+        REQUIRE( pop_value(*eth) == 2 );
+
+        for (int i = 0; i < 16; i++) {
+            dispatcher.dispatch({.product_id = "BTC-USD", .number = i});
+        }
+
+        REQUIRE( btc->pop(timeout).state == PopState::overflow );
+        REQUIRE( eth->pop(timeout).state == PopState::timeout );
+    }
+
+    SECTION( "subscriber replays values retained by ring" ) {
+        dispatcher.dispatch({.product_id = "BTC-USD", .number = 3});
+
+        auto last = dispatcher.subscribe(std::string{"BTC-USD"}, 1);
+        REQUIRE( pop_value(*last) == 3 );
+        REQUIRE( last->pop(timeout).state == PopState::timeout );
+
+        // replay is limited to values dispatched so far
+        auto all = dispatcher.subscribe(std::string{"BTC-USD"}, 10);
+        REQUIRE( pop_value(*all) == 1 );
+        REQUIRE( pop_value(*all) == 3 );
+        REQUIRE( all->pop(timeout).state == PopState::timeout );
+    }
+}
+
+TEST_CASE( "Dispatcher subscribes while dispatching", "[dispatcher]" ) {
+    constexpr int count = 100000;
+
+    Dispatcher<Value> dispatcher{16, &Value::product_id};
+
+    auto producer = std::async(std::launch::async, [&] {
+        for (int i = 0; i < count; i++) {
+            dispatcher.dispatch({.product_id = std::to_string(i % 8), .number = i});
+        }
+    });
+
+    // subscribers come and go, rings without subscribers are reused or pruned and recreated
+    for (int i = 0; producer.wait_for(std::chrono::seconds(0)) != std::future_status::ready; i++) {
+        auto key = std::to_string(i % 16);
+        auto subscriber = dispatcher.subscribe(key);
+        auto [res, state] = subscriber->pop(std::chrono::milliseconds(1));
+
+        if (state == PopState::valid) {
+            REQUIRE( (*res)->value().product_id == key );
+        }
+    }
+
+    producer.get();
+
+    auto subscriber = dispatcher.subscribe("0");
+    dispatcher.dispatch({.product_id = "0", .number = count});
+
+    REQUIRE( pop_value(*subscriber) == count );
+}
+
+TEST_CASE( "Dispatcher releases ring once its subscribers are gone", "[dispatcher]" ) {
+    Dispatcher<Value> dispatcher{16, &Value::product_id};
+
+    auto btc = dispatcher.subscribe(std::string{"BTC-USD"});
+    auto eth = dispatcher.subscribe(std::string{"ETH-USD"});
+
+    // value is retained by ring until the ring is released
+    auto message = std::make_shared<const Envelope<Value>>(Value{.product_id = "ETH-USD", .number = 1});
+    std::weak_ptr<const Envelope<Value>> retained = message;
+    dispatcher.dispatch(std::move(message));
+
+    REQUIRE( pop_value(*eth) == 1 );
+    REQUIRE( !retained.expired() );
+
+    // dispatches of other key keep snapshots of registry in use
+    std::atomic<bool> running{true};
+    auto producer = std::async(std::launch::async, [&] {
+        for (int i = 0; running; i++) {
+            dispatcher.dispatch({.product_id = "BTC-USD", .number = i});
+        }
+    });
+
+    eth.reset();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!retained.expired() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    running = false;
+    producer.get();
+
+    REQUIRE( retained.expired() );
+
+    // key is subscribed again with new ring
+    eth = dispatcher.subscribe(std::string{"ETH-USD"}, 1);
+    dispatcher.dispatch({.product_id = "ETH-USD", .number = 2});
+
+    REQUIRE( pop_value(*eth) == 2 );
+    REQUIRE( btc->pop(std::chrono::milliseconds(1)).state != PopState::timeout );
+}
+
+TEST_CASE( "Dispatcher dispatches keys concurrently", "[dispatcher]" ) {
+    constexpr int count = 1000;
+
+    Dispatcher<Value> dispatcher{4096, &Value::product_id};
+
+    auto btc = dispatcher.subscribe(std::string{"BTC-USD"});
+    auto eth = dispatcher.subscribe(std::string{"ETH-USD"});
+    auto all = dispatcher.subscribe();
+
+    auto produce = [&](std::string product_id) {
+        return std::async(std::launch::async, [&dispatcher, product_id] {
+            for (int i = 0; i < count; i++) {
+                dispatcher.dispatch({.product_id = product_id, .number = i});
+            }
+        });
+    };
+
+    auto p1 = produce("BTC-USD");
+    auto p2 = produce("ETH-USD");
+    p1.get();
+    p2.get();
+
+    // each key keeps its order, filtered ring receives values of both keys
+    for (int i = 0; i < count; i++) {
+        REQUIRE( pop_value(*btc) == i );
+        REQUIRE( pop_value(*eth) == i );
+    }
+
+    int received = 0;
+    while (pop_value(*all) != -1) {
+        received++;
+    }
+
+    REQUIRE( received == 2 * count );
+}
+
+TEST_CASE( "Subscriber watch is invoked by dispatch", "[dispatcher]" ) {
+    Dispatcher<Value> dispatcher{16, &Value::product_id};
+
+    auto btc = dispatcher.subscribe(std::string{"BTC-USD"});
+
+    int woken = 0;
+    Signal::Watch watch{[&woken] { woken++; }};
+
+    REQUIRE( btc->watch(watch) );
+
+    // values of other keys are in other ring
+    dispatcher.dispatch({.product_id = "ETH-USD", .number = 1});
+    REQUIRE( woken == 0 );
+
+    dispatcher.dispatch({.product_id = "BTC-USD", .number = 2});
+    REQUIRE( woken == 1 );
+
+    // available message is taken without watch
+    REQUIRE( !btc->watch(watch) );
+    REQUIRE( pop_value(*btc) == 2 );
+    REQUIRE( btc->watch(watch) );
+}
@@ -0,0 +1,156 @@
+#ifndef FLAT_MAP_H
+#define FLAT_MAP_H 1
+
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// FlatMap is open-addressing hash map with linear probing stored in single contiguous array.
+// Erased entries are backfilled by shifting following entries of the probe sequence,
+// so lookups never have to skip tombstones. Table is kept at most half full.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class FlatMap {
+public:
+    explicit FlatMap(std::pmr::memory_resource* mr = std::pmr::get_default_resource()): _slots(mr) {};
+    FlatMap(const FlatMap& other, std::pmr::memory_resource* mr): _slots(other._slots, mr), _size(other._size) {};
+
+    FlatMap(const FlatMap&) = default;
+    FlatMap(FlatMap&&) = default;
+
+    inline std::size_t size() const { return _size; };
+    inline bool empty() const { return _size == 0; };
+
+    // reserve grows table so that n entries fit without rehashing
+    void reserve(std::size_t n);
+
+    // find returns value of key or nullptr if key is missing
+    V* find(const K& key);
+    const V* find(const K& key) const;
+
+    // emplace inserts value if key is missing, returns false if key was present
+    bool emplace(const K& key, V value);
+
+    // erase removes key, returns false if key was missing
+    bool erase(const K& key);
+
+private:
+    struct Slot {
+        std::optional<std::pair<K, V>> entry;
+    };
+
+    std::pmr::vector<Slot> _slots;
+    std::size_t _size = 0;
+
+    inline std::size_t mask() const { return _slots.size() - 1; };
+    inline std::size_t home(const K& key) const { return Hash{}(key) & mask(); };
+
+    std::optional<std::size_t> lookup(const K& key) const;
+    void rehash(std::size_t capacity);
+};
+
+template <typename K, typename V, typename Hash>
+void FlatMap<K, V, Hash>::reserve(std::size_t n) {
+    auto capacity = std::bit_ceil(std::max<std::size_t>(n * 2, 8));
+    if (capacity > _slots.size()) {
+        rehash(capacity);
+    };
+};
+
+template <typename K, typename V, typename Hash>
+V* FlatMap<K, V, Hash>::find(const K& key) {
+    auto pos = lookup(key);
+    return pos ? &_slots[*pos].entry->second : nullptr;
+};
+
+template <typename K, typename V, typename Hash>
+const V* FlatMap<K, V, Hash>::find(const K& key) const {
+    auto pos = lookup(key);
+    return pos ? &_slots[*pos].entry->second : nullptr;
+};
+
+template <typename K, typename V, typename Hash>
+bool FlatMap<K, V, Hash>::emplace(const K& key, V value) {
+    if ((_size + 1) * 2 > _slots.size()) {
+        rehash(std::max<std::size_t>(_slots.size() * 2, 8));
+    };
+
+    auto pos = home(key);
+    for (; _slots[pos].entry; pos = (pos + 1) & mask()) {
+        if (_slots[pos].entry->first == key) {
+            return false;
+        };
+    };
+
+    _slots[pos].entry.emplace(key, std::move(value));
+    _size++;
+
+    return true;
+};
+
+template <typename K, typename V, typename Hash>
+bool FlatMap<K, V, Hash>::erase(const K& key) {
+    auto found = lookup(key);
+    if (!found) {
+        return false;
+    };
+
+    auto hole = *found;
+    _slots[hole].entry.reset();
+    _size--;
+
+    // move back entries whose probe sequence passes through the hole
+    for (auto pos = (hole + 1) & mask(); _slots[pos].entry; pos = (pos + 1) & mask()) {
+        auto ideal = home(_slots[pos].entry->first);
+
+        // entry stays if its home lies cyclically in (hole, pos]
+        if (((pos - ideal) & mask()) < ((pos - hole) & mask())) {
+            continue;
+        };
+
+        _slots[hole].entry = std::move(_slots[pos].entry);
+        _slots[pos].entry.reset();
+        hole = pos;
+    };
+
+    return true;
+};
+
+template <typename K, typename V, typename Hash>
+std::optional<std::size_t> FlatMap<K, V, Hash>::lookup(const K& key) const {
+    if (_slots.empty()) {
+        return std::nullopt;
+    };
+
+    for (auto pos = home(key); _slots[pos].entry; pos = (pos + 1) & mask()) {
+        if (_slots[pos].entry->first == key) {
+            return pos;
+        };
+    };
+
+    return std::nullopt;
+};
+
+template <typename K, typename V, typename Hash>
+void FlatMap<K, V, Hash>::rehash(std::size_t capacity) {
+    std::pmr::vector<Slot> slots(capacity, _slots.get_allocator());
+    std::swap(slots, _slots);
+
+    for (auto& slot: slots) {
+        if (!slot.entry) {
+            continue;
+        };
+
+        auto pos = home(slot.entry->first);
+        while (_slots[pos].entry) {
+            pos = (pos + 1) & mask();
+        };
+
+        _slots[pos].entry = std::move(slot.entry);
+    };
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include "flat_map.h"
+
+#include <random>
+#include <unordered_map>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE( "FlatMap", "[flat_map]" ) {
+    FlatMap<int, int> map;
+
+    SECTION( "emplace, find and erase" ) {
+        REQUIRE( map.find(1) == nullptr );
+        REQUIRE( map.emplace(1, 10) );
+        REQUIRE( !map.emplace(1, 20) );
+        REQUIRE( *map.find(1) == 10 );
+        REQUIRE( map.size() == 1 );
+
+        REQUIRE( map.erase(1) );
+        REQUIRE( !map.erase(1) );
+        REQUIRE( map.find(1) == nullptr );
+        REQUIRE( map.empty() );
+    }
+
+    SECTION( "matches unordered_map" ) {
+        // small key range forces collisions and erasure inside probe sequences
+        std::unordered_map<int, int> expected;
+        std::mt19937 rng{42};
+
+        for (int i = 0; i < 100000; i++) {
+            int key = rng() % 512;
+
+            if (rng() % 2) {
+                REQUIRE( map.emplace(key, i) == expected.emplace(key, i).second );
+            } else {
+                REQUIRE( map.erase(key) == (expected.erase(key) == 1) );
+            };
+        };
+
+        REQUIRE( map.size() == expected.size() );
+        for (int key = 0; key < 512; key++) {
+            auto it = expected.find(key);
+            auto value = map.find(key);
+
+            REQUIRE( (it == expected.end() ? value == nullptr : value != nullptr && *value == it->second) );
+        };
+    }
+}
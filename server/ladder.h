@@ -0,0 +1,322 @@
+#ifndef LADDER_H
+#define LADDER_H 1
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "decimal.h"
+#include "flat_map.h"
+
+// PriceLevel aggregates orders with the same price
+struct PriceLevel {
+    Decimal price;
+    Decimal size;
+    std::size_t count;
+
+    bool operator==(const PriceLevel&) const = default;
+};
+
+// Ladder holds orders of one orderbook side.
+// Price levels are kept in contiguous vector sorted from the worst price to the best one,
+// so that levels near the touch are inserted and removed by moving only few elements.
+// Orders of each level form intrusive FIFO list of nodes allocated from pool,
+// order id maps to node so that modify and cancel do not search the level.
+// Entry is expected to have order_id, price and size members, Better orders prices from the best one.
+template <typename Entry, typename Better>
+class Ladder {
+public:
+    using Key = decltype(Entry::order_id);
+
+    class const_iterator;
+    using iterator = const_iterator;
+
+    // containers of ladder are allocated from mr
+    explicit Ladder(std::pmr::memory_resource* mr = std::pmr::get_default_resource()): _levels(mr), _nodes(mr), _index(mr) {};
+
+    // Ladder is loaded from entries in any price order, entries with equal price keep their order.
+    // Entries already sorted from the best or the worst price are loaded without copying and sorting them.
+    template <typename Range>
+    explicit Ladder(const Range& entries, std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+
+    Ladder(const Ladder& other, std::pmr::memory_resource* mr): _levels(other._levels, mr), _nodes(other._nodes, mr), _free(other._free), _index(other._index, mr) {};
+
+    Ladder(const Ladder&) = default;
+    Ladder(Ladder&&) = default;
+
+    // begin iterates entries from the best price, entries with equal price in order of arrival
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // size returns number of orders
+    inline std::size_t size() const { return _index.size(); };
+    inline bool empty() const { return _index.empty(); };
+
+    // levels returns number of price levels
+    inline std::size_t levels() const { return _levels.size(); };
+
+    // level returns n-th best price level
+    inline const PriceLevel& level(std::size_t n) const { return _levels[_levels.size() - 1 - n].level; };
+
+    // rank returns number of levels with better price, ie. position of level at price from the best one
+    std::size_t rank(const Decimal& price) const;
+
+    // find returns entry of order or nullptr if order is not in ladder
+    const Entry* find(const Key& order_id) const;
+
+    // insert appends order to the end of its price level
+    void insert(const Entry& entry);
+
+    // resize replaces size of existing order
+    void resize(const Key& order_id, const Decimal& size);
+
+    // erase removes existing order
+    void erase(const Key& order_id);
+
+private:
+    static constexpr std::uint32_t nil = std::numeric_limits<std::uint32_t>::max();
+
+    struct Node {
+        Entry entry;
+        std::uint32_t prev;
+        std::uint32_t next;
+    };
+
+    struct Level {
+        PriceLevel level;
+        std::uint32_t head;
+        std::uint32_t tail;
+    };
+
+    std::pmr::vector<Level> _levels;
+    std::pmr::vector<Node> _nodes;
+    // head of list of released nodes linked by next
+    std::uint32_t _free = nil;
+    FlatMap<Key, std::uint32_t> _index;
+
+    // lower_bound returns the first level that is not worse than price
+    typename std::pmr::vector<Level>::iterator lower_bound(const Decimal& price);
+    typename std::pmr::vector<Level>::iterator find_level(const Decimal& price);
+
+    // load appends entries sorted from the worst or the best price as levels in the same order
+    template <typename Iterator>
+    void load(Iterator first, Iterator last);
+
+    std::uint32_t allocate(const Entry& entry);
+    void append(Level& level, std::uint32_t node);
+    std::uint32_t node(const Key& order_id) const;
+};
+
+template <typename Entry, typename Better>
+class Ladder<Entry, Better>::const_iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Entry;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Entry*;
+    using reference = const Entry&;
+
+    const_iterator() = default;
+
+    inline reference operator*() const { return _ladder->_nodes[_node].entry; };
+    inline pointer operator->() const { return &_ladder->_nodes[_node].entry; };
+
+    const_iterator& operator++() {
+        _node = _ladder->_nodes[_node].next;
+
+        // continue with the next worse level
+        if (_node == nil && ++_level < _ladder->_levels.size()) {
+            _node = _ladder->_levels[_ladder->_levels.size() - 1 - _level].head;
+        };
+
+        return *this;
+    };
+
+    const_iterator operator++(int) { auto res = *this; ++(*this); return res; };
+
+    bool operator==(const const_iterator& rhs) const { return _level == rhs._level && _node == rhs._node; };
+    bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); };
+
+private:
+    friend class Ladder;
+
+    const_iterator(const Ladder* ladder, std::size_t level): _ladder(ladder), _level(level) {
+        _node = level < ladder->_levels.size() ? ladder->_levels[ladder->_levels.size() - 1 - level].head : nil;
+    };
+
+    const Ladder* _ladder = nullptr;
+    // level counted from the best one
+    std::size_t _level = 0;
+    std::uint32_t _node = nil;
+};
+
+template <typename Entry, typename Better>
+template <typename Range>
+Ladder<Entry, Better>::Ladder(const Range& entries, std::pmr::memory_resource* mr): Ladder(mr) {
+    auto better = [](const auto& lhs, const auto& rhs) { return Better{}(lhs.price, rhs.price); };
+    auto worse = [](const auto& lhs, const auto& rhs) { return Better{}(rhs.price, lhs.price); };
+
+    // bulk load appends levels instead of inserting each in place, levels are kept from the worst one
+    if (std::is_sorted(std::begin(entries), std::end(entries), better)) {
+        load(std::begin(entries), std::end(entries));
+        std::reverse(_levels.begin(), _levels.end());
+    } else if (std::is_sorted(std::begin(entries), std::end(entries), worse)) {
+        load(std::begin(entries), std::end(entries));
+    } else {
+        std::vector<Entry> sorted{std::begin(entries), std::end(entries)};
+        std::stable_sort(sorted.begin(), sorted.end(), worse);
+        load(sorted.begin(), sorted.end());
+    };
+};
+
+template <typename Entry, typename Better>
+typename Ladder<Entry, Better>::const_iterator Ladder<Entry, Better>::begin() const {
+    return const_iterator{this, 0};
+};
+
+template <typename Entry, typename Better>
+typename Ladder<Entry, Better>::const_iterator Ladder<Entry, Better>::end() const {
+    return const_iterator{this, _levels.size()};
+};
+
+template <typename Entry, typename Better>
+std::size_t Ladder<Entry, Better>::rank(const Decimal& price) const {
+    auto it = std::partition_point(_levels.begin(), _levels.end(), [&price](const auto& level) {
+        return !Better{}(level.level.price, price);
+    });
+
+    return std::distance(it, _levels.end());
+};
+
+template <typename Entry, typename Better>
+const Entry* Ladder<Entry, Better>::find(const Key& order_id) const {
+    auto node = _index.find(order_id);
+    if (node == nullptr) {
+        return nullptr;
+    };
+
+    return &_nodes[*node].entry;
+};
+
+template <typename Entry, typename Better>
+void Ladder<Entry, Better>::insert(const Entry& entry) {
+    auto it = lower_bound(entry.price);
+    if (it == _levels.end() || it->level.price != entry.price) {
+        it = _levels.insert(it, Level{.level = {.price = entry.price, .size = Decimal{}, .count = 0}, .head = nil, .tail = nil});
+    };
+
+    auto node = allocate(entry);
+    append(*it, node);
+    _index.emplace(entry.order_id, node);
+};
+
+template <typename Entry, typename Better>
+void Ladder<Entry, Better>::resize(const Key& order_id, const Decimal& size) {
+    auto& entry = _nodes[node(order_id)].entry;
+
+    find_level(entry.price)->level.size += size - entry.size;
+    entry.size = size;
+};
+
+template <typename Entry, typename Better>
+void Ladder<Entry, Better>::erase(const Key& order_id) {
+    auto idx = node(order_id);
+    auto& n = _nodes[idx];
+    auto level = find_level(n.entry.price);
+
+    // unlink node from level
+    (n.prev != nil ? _nodes[n.prev].next : level->head) = n.next;
+    (n.next != nil ? _nodes[n.next].prev : level->tail) = n.prev;
+
+    if (--level->level.count == 0) {
+        _levels.erase(level);
+    } else {
+        level->level.size -= n.entry.size;
+    };
+
+    _index.erase(order_id);
+
+    n.entry = Entry{};
+    n.next = _free;
+    _free = idx;
+};
+
+template <typename Entry, typename Better>
+typename std::pmr::vector<typename Ladder<Entry, Better>::Level>::iterator Ladder<Entry, Better>::lower_bound(const Decimal& price) {
+    return std::lower_bound(_levels.begin(), _levels.end(), price, [](const auto& level, const auto& price) {
+        return Better{}(price, level.level.price);
+    });
+};
+
+template <typename Entry, typename Better>
+typename std::pmr::vector<typename Ladder<Entry, Better>::Level>::iterator Ladder<Entry, Better>::find_level(const Decimal& price) {
+    auto it = lower_bound(price);
+    if (it == _levels.end() || it->level.price != price) {
+        throw std::logic_error("missing price level");
+    };
+
+    return it;
+};
+
+template <typename Entry, typename Better>
+template <typename Iterator>
+void Ladder<Entry, Better>::load(Iterator first, Iterator last) {
+    auto size = std::distance(first, last);
+    _nodes.reserve(size);
+    _index.reserve(size);
+
+    for (; first != last; ++first) {
+        const Entry& entry = *first;
+
+        if (_levels.empty() || _levels.back().level.price != entry.price) {
+            _levels.push_back(Level{.level = {.price = entry.price, .size = Decimal{}, .count = 0}, .head = nil, .tail = nil});
+        };
+
+        auto node = allocate(entry);
+        append(_levels.back(), node);
+        _index.emplace(entry.order_id, node);
+    };
+};
+
+template <typename Entry, typename Better>
+std::uint32_t Ladder<Entry, Better>::allocate(const Entry& entry) {
+    if (_free == nil) {
+        _nodes.push_back(Node{.entry = entry, .prev = nil, .next = nil});
+        return _nodes.size() - 1;
+    };
+
+    auto idx = _free;
+    _free = _nodes[idx].next;
+    _nodes[idx] = Node{.entry = entry, .prev = nil, .next = nil};
+
+    return idx;
+};
+
+template <typename Entry, typename Better>
+void Ladder<Entry, Better>::append(Level& level, std::uint32_t idx) {
+    auto& n = _nodes[idx];
+
+    n.prev = level.tail;
+    (level.tail != nil ? _nodes[level.tail].next : level.head) = idx;
+    level.tail = idx;
+
+    level.level.size += n.entry.size;
+    level.level.count++;
+};
+
+template <typename Entry, typename Better>
+std::uint32_t Ladder<Entry, Better>::node(const Key& order_id) const {
+    auto node = _index.find(order_id);
+    if (node == nullptr) {
+        throw std::invalid_argument("missing entry in update");
+    };
+
+    return *node;
+};
+
+#endif
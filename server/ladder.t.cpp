@@ -0,0 +1,102 @@
+#include "ladder.h"
+
+#include <functional>
+
+#include <catch2/catch.hpp>
+
+namespace {
+    struct Entry {
+        std::string order_id;
+        Decimal price;
+        Decimal size;
+
+        bool operator==(const Entry&) const = default;
+    };
+
+    using Bids = Ladder<Entry, std::greater<Decimal>>;
+
+    std::vector<Entry> entries(const Bids& ladder) {
+        return {ladder.begin(), ladder.end()};
+    };
+} // anonymous namespace
+
+TEST_CASE( "Ladder", "[ladder]" ) {
+    Bids ladder{std::vector<Entry>{
+        {.order_id = "a", .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+        {.order_id = "b", .price = Decimal{"2.0"}, .size = Decimal{"1.0"}},
+        {.order_id = "c", .price = Decimal{"1.0"}, .size = Decimal{"2.0"}},
+    }};
+
+    SECTION( "entries are ordered by price and arrival" ) {
+        REQUIRE( entries(ladder) == std::vector<Entry>{
+            {.order_id = "b", .price = Decimal{"2.0"}, .size = Decimal{"1.0"}},
+            {.order_id = "a", .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+            {.order_id = "c", .price = Decimal{"1.0"}, .size = Decimal{"2.0"}},
+        } );
+
+        REQUIRE( ladder.levels() == 2 );
+        REQUIRE( ladder.level(0) == PriceLevel{.price = Decimal{"2.0"}, .size = Decimal{"1.0"}, .count = 1} );
+        REQUIRE( ladder.level(1) == PriceLevel{.price = Decimal{"1.0"}, .size = Decimal{"3.0"}, .count = 2} );
+
+        // rank counts better levels whether price has level or not
+        REQUIRE( ladder.rank(Decimal{"3.0"}) == 0 );
+        REQUIRE( ladder.rank(Decimal{"2.0"}) == 0 );
+        REQUIRE( ladder.rank(Decimal{"1.5"}) == 1 );
+        REQUIRE( ladder.rank(Decimal{"1.0"}) == 1 );
+        REQUIRE( ladder.rank(Decimal{"0.5"}) == 2 );
+    }
+
+    SECTION( "sorted entries are loaded in place" ) {
+        auto best_first = std::vector<Entry>{
+            {.order_id = "b", .price = Decimal{"2.0"}, .size = Decimal{"1.0"}},
+            {.order_id = "a", .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+            {.order_id = "c", .price = Decimal{"1.0"}, .size = Decimal{"2.0"}},
+        };
+        auto worst_first = std::vector<Entry>{best_first[1], best_first[2], best_first[0]};
+
+        for (const auto& loaded: {Bids{best_first}, Bids{worst_first}}) {
+            REQUIRE( entries(loaded) == entries(ladder) );
+            REQUIRE( loaded.levels() == 2 );
+            REQUIRE( loaded.level(0) == ladder.level(0) );
+            REQUIRE( loaded.level(1) == ladder.level(1) );
+        };
+    }
+
+    SECTION( "insert appends to level" ) {
+        ladder.insert({.order_id = "d", .price = Decimal{"1.0"}, .size = Decimal{"1.0"}});
+        ladder.insert({.order_id = "e", .price = Decimal{"3.0"}, .size = Decimal{"1.0"}});
+
+        REQUIRE( entries(ladder) == std::vector<Entry>{
+            {.order_id = "e", .price = Decimal{"3.0"}, .size = Decimal{"1.0"}},
+            {.order_id = "b", .price = Decimal{"2.0"}, .size = Decimal{"1.0"}},
+            {.order_id = "a", .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+            {.order_id = "c", .price = Decimal{"1.0"}, .size = Decimal{"2.0"}},
+            {.order_id = "d", .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+        } );
+        REQUIRE( ladder.level(2).count == 3 );
+    }
+
+    SECTION( "resize and erase keep levels" ) {
+        ladder.resize("c", Decimal{"0.5"});
+        ladder.erase("a");
+        ladder.erase("b");
+
+        REQUIRE( ladder.find("a") == nullptr );
+        REQUIRE( ladder.find("c")->size == Decimal{"0.5"} );
+        REQUIRE( ladder.size() == 1 );
+        REQUIRE( ladder.levels() == 1 );
+        REQUIRE( ladder.level(0) == PriceLevel{.price = Decimal{"1.0"}, .size = Decimal{"0.5"}, .count = 1} );
+
+        // released nodes are reused
+        ladder.insert({.order_id = "d", .price = Decimal{"1.0"}, .size = Decimal{"1.0"}});
+
+        REQUIRE( entries(ladder) == std::vector<Entry>{
+            {.order_id = "c", .price = Decimal{"1.0"}, .size = Decimal{"0.5"}},
+            {.order_id = "d", .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+        } );
+    }
+
+    SECTION( "missing order" ) {
+        REQUIRE_THROWS_AS( ladder.erase("x"), std::invalid_argument );
+    }
+}
@@ -0,0 +1,79 @@
+#include "level_view.h"
+
+Level2View::Level2View(std::size_t depth, const OrderBook::Depth& levels): _depth(depth), _sequence(levels.sequence), _bids(levels.bids), _asks(levels.asks) {
+
+};
+
+OrderBook::Depth Level2View::levels() const {
+    return {.sequence = _sequence, .bids = _bids.best(_depth), .asks = _asks.best(_depth)};
+};
+
+void Level2View::apply(const Level2& change, const Fetch& fetch, std::vector<Changes>& out) {
+    // replaced orderbook may repeat sequence of the stale one, its levels are read again anyway
+    if (!change.resync && !is_new(change, _sequence)) {
+        return;
+    };
+
+    // levels are not updated until stale orderbook is replaced
+    if (change.stale) {
+        if (_stale) {
+            return;
+        };
+
+        flush(out);
+        out.push_back({.sequence = change.sequence, .stale = true});
+
+        _stale = true;
+        _sequence = change.sequence;
+        return;
+    };
+
+    // levels within depth are copied only before the first change that may modify them
+    auto within = [this](const auto& side, const auto& changes) {
+        return std::any_of(changes.begin(), changes.end(), [&](const auto& level) {
+            return side.within(_depth, level.price);
+        });
+    };
+
+    if (!_written && (change.resync || within(_bids, change.bids) || within(_asks, change.asks))) {
+        _written = levels();
+    };
+
+    // orderbook was replaced, its levels are read again and diff is written
+    if (change.resync) {
+        auto next = fetch();
+
+        // orderbook became stale again, stale change follows and nothing is written until the next resync
+        if (!next) {
+            _written.reset();
+            return;
+        };
+
+        _bids = LevelView<std::greater<Decimal>>{next->bids};
+        _asks = LevelView<std::less<Decimal>>{next->asks};
+        _sequence = next->sequence;
+        return;
+    };
+
+    _bids.apply(change.bids);
+    _asks.apply(change.asks);
+    _sequence = change.sequence;
+};
+
+void Level2View::flush(std::vector<Changes>& out) {
+    if (!_written) {
+        return;
+    };
+
+    auto bids = diff_levels(_written->bids, _bids.best(_depth));
+    auto asks = diff_levels(_written->asks, _asks.best(_depth));
+    _written.reset();
+
+    // message following stale one is sent even if levels did not change
+    if (bids.empty() && asks.empty() && !_stale) {
+        return;
+    };
+
+    _stale = false;
+    out.push_back({.sequence = _sequence, .bids = std::move(bids), .asks = std::move(asks)});
+};
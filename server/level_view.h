@@ -0,0 +1,98 @@
+#ifndef LEVEL_VIEW_H
+#define LEVEL_VIEW_H 1
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "decimal.h"
+#include "orderbook.h"
+
+// LevelView is copy of level2_depth best levels of one side kept by level2 stream and updated by dispatched changes
+// Levels are sorted from the worst price as in Ladder, so that changes near the touch move only few elements.
+// Better orders prices from the best one.
+template <typename Better>
+class LevelView {
+public:
+    explicit LevelView(const std::vector<OrderBook::Level>& best): _levels(best.rbegin(), best.rend()) {};
+
+    // within returns true if change of level at price may change depth best levels
+    bool within(std::size_t depth, const Decimal& price) const {
+        return _levels.size() < depth || !Better{}(_levels[_levels.size() - depth].price, price);
+    };
+
+    // best returns up to depth best levels from the best one
+    std::vector<OrderBook::Level> best(std::size_t depth) const {
+        return {_levels.rbegin(), _levels.rbegin() + std::min(depth, _levels.size())};
+    };
+
+    // apply replaces levels with changed ones, levels with zero count are removed
+    void apply(const LevelChanges& changes) {
+        for (const auto& change: changes) {
+            auto it = std::partition_point(_levels.begin(), _levels.end(), [&change](const auto& level) {
+                return Better{}(change.price, level.price);
+            });
+            auto found = it != _levels.end() && it->price == change.price;
+
+            if (change.count == 0) {
+                if (found) {
+                    _levels.erase(it);
+                };
+            } else if (found) {
+                *it = change;
+            } else {
+                _levels.insert(it, change);
+            };
+        };
+    };
+
+private:
+    std::vector<OrderBook::Level> _levels;
+};
+
+// Level2View keeps levels of product for level2 stream of depth and collects changes of levels within depth.
+// Changes of batch are written at once by flush as difference to levels that were written before them,
+// so that levels changed back and forth within batch are not written at all.
+// Level2View is owned by single stream, it is not synchronized.
+class Level2View {
+public:
+    // Changes are levels within depth that changed since the previous ones, removed levels have zero size and count
+    // Stale changes have no levels.
+    struct Changes {
+        std::int64_t sequence;
+        std::vector<OrderBook::Level> bids;
+        std::vector<OrderBook::Level> asks;
+        bool stale = false;
+    };
+
+    // Fetch reads level2_depth levels of replaced orderbook, returns nothing if it became stale again
+    using Fetch = std::function<std::optional<OrderBook::Depth>()>;
+
+    Level2View(std::size_t depth, const OrderBook::Depth& levels);
+
+    inline std::int64_t sequence() const { return _sequence; };
+
+    // levels returns levels within depth
+    OrderBook::Depth levels() const;
+
+    // apply applies dispatched change, stale change appends its message to out
+    void apply(const Level2& change, const Fetch& fetch, std::vector<Changes>& out);
+
+    // flush appends changes of levels within depth since they were written
+    void flush(std::vector<Changes>& out);
+
+private:
+    const std::size_t _depth;
+
+    std::int64_t _sequence;
+    LevelView<std::greater<Decimal>> _bids;
+    LevelView<std::less<Decimal>> _asks;
+
+    // levels within depth before changes that were not written yet
+    std::optional<OrderBook::Depth> _written;
+    bool _stale = false;
+};
+
+#endif
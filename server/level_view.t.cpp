@@ -0,0 +1,219 @@
+#include "level_view.h"
+
+#include <catch2/catch.hpp>
+
+namespace {
+    OrderBook::Level level(const char* price, const char* size, std::size_t count = 1) {
+        return {.price = Decimal{price}, .size = Decimal{size}, .count = count};
+    };
+
+    Level2 change(std::int64_t sequence, LevelChanges bids, LevelChanges asks = {}) {
+        return {.product_id = "BTC-USD", .sequence = sequence, .bids = std::move(bids), .asks = std::move(asks)};
+    };
+} // anonymous namespace
+
+TEST_CASE( "LevelView", "[level_view]" ) {
+    LevelView<std::greater<Decimal>> bids{{level("3", "1.0"), level("2", "1.0"), level("1", "1.0")}};
+
+    SECTION( "within depth" ) {
+        // prices at or above the worst level within depth may change it
+        REQUIRE( bids.within(2, Decimal{"4"}) );
+        REQUIRE( bids.within(2, Decimal{"2"}) );
+        REQUIRE( bids.within(2, Decimal{"2.5"}) );
+        REQUIRE( !bids.within(2, Decimal{"1.5"}) );
+        REQUIRE( !bids.within(2, Decimal{"1"}) );
+
+        // view with fewer levels than depth is changed by any price
+        REQUIRE( bids.within(4, Decimal{"0.5"}) );
+    }
+
+    SECTION( "best levels are ordered from the best price" ) {
+        REQUIRE( bids.best(2) == std::vector<OrderBook::Level>{level("3", "1.0"), level("2", "1.0")} );
+        REQUIRE( bids.best(5).size() == 3 );
+    }
+
+    SECTION( "changes insert, replace and remove levels" ) {
+        bids.apply({level("2.5", "2.0"), level("3", "0.5", 2)});
+        bids.apply({level("1", "0", 0)});
+
+        REQUIRE( bids.best(5) == std::vector<OrderBook::Level>{level("3", "0.5", 2), level("2.5", "2.0"), level("2", "1.0")} );
+
+        // removal of missing level is ignored
+        bids.apply({level("1.5", "0", 0)});
+
+        REQUIRE( bids.best(5).size() == 3 );
+    }
+
+    SECTION( "asks are ordered from the lowest price" ) {
+        LevelView<std::less<Decimal>> asks{{level("4", "1.0"), level("5", "1.0")}};
+        asks.apply({level("3.5", "1.0"), level("6", "1.0")});
+
+        REQUIRE( asks.best(3) == std::vector<OrderBook::Level>{level("3.5", "1.0"), level("4", "1.0"), level("5", "1.0")} );
+        REQUIRE( asks.within(3, Decimal{"4.5"}) );
+        REQUIRE( !asks.within(3, Decimal{"5.5"}) );
+    }
+}
+
+TEST_CASE( "Level2View", "[level_view]" ) {
+    Level2View view{2, {
+        .sequence = 1,
+        .bids = {level("3", "1.0"), level("2", "1.0"), level("1", "1.0")},
+        .asks = {level("4", "1.0"), level("5", "1.0"), level("6", "1.0")},
+    }};
+
+    std::optional<OrderBook::Depth> fetched;
+    int fetches = 0;
+    Level2View::Fetch fetch = [&] {
+        fetches++;
+        return fetched;
+    };
+
+    std::vector<Level2View::Changes> out;
+
+    SECTION( "levels are limited to depth" ) {
+        auto levels = view.levels();
+
+        REQUIRE( levels.sequence == 1 );
+        REQUIRE( levels.bids == std::vector<OrderBook::Level>{level("3", "1.0"), level("2", "1.0")} );
+        REQUIRE( levels.asks == std::vector<OrderBook::Level>{level("4", "1.0"), level("5", "1.0")} );
+    }
+
+    SECTION( "changes outside depth are not written" ) {
+        view.apply(change(2, {level("1", "2.0")}, {level("6", "0", 0)}), fetch, out);
+        view.flush(out);
+
+        REQUIRE( out.empty() );
+        REQUIRE( view.sequence() == 2 );
+    }
+
+    SECTION( "changes of batch are written as one diff" ) {
+        view.apply(change(2, {level("3", "2.0")}), fetch, out);
+        view.apply(change(3, {}, {level("4", "0.5")}), fetch, out);
+        view.apply(change(4, {level("3", "1.5")}), fetch, out);
+
+        REQUIRE( out.empty() );
+
+        view.flush(out);
+
+        REQUIRE( out.size() == 1 );
+        REQUIRE( out[0].sequence == 4 );
+        REQUIRE( out[0].bids == std::vector<OrderBook::Level>{level("3", "1.5")} );
+        REQUIRE( out[0].asks == std::vector<OrderBook::Level>{level("4", "0.5")} );
+        REQUIRE( !out[0].stale );
+
+        // nothing is written until levels change again
+        view.flush(out);
+
+        REQUIRE( out.size() == 1 );
+    }
+
+    SECTION( "level changed back within batch is not written" ) {
+        view.apply(change(2, {level("3", "2.0")}), fetch, out);
+        view.apply(change(3, {level("3", "1.0")}), fetch, out);
+        view.flush(out);
+
+        REQUIRE( out.empty() );
+    }
+
+    SECTION( "levels crossing depth boundary" ) {
+        // new best level pushes the worst one out of depth, it is sent with zero size
+        view.apply(change(2, {level("3.5", "1.0")}), fetch, out);
+        view.flush(out);
+
+        REQUIRE( out.size() == 1 );
+        REQUIRE( out[0].bids == std::vector<OrderBook::Level>{level("3.5", "1.0"), level("2", "0", 0)} );
+
+        // removed level lets the next one in with its whole size
+        view.apply(change(3, {level("3", "0", 0)}), fetch, out);
+        view.flush(out);
+
+        REQUIRE( out.size() == 2 );
+        REQUIRE( out[1].sequence == 3 );
+        REQUIRE( out[1].bids == std::vector<OrderBook::Level>{level("2", "1.0"), level("3", "0", 0)} );
+    }
+
+    SECTION( "changes that are already applied are ignored" ) {
+        view.apply(change(1, {level("3", "2.0")}), fetch, out);
+        view.apply(change(0, {level("3", "2.0")}), fetch, out);
+        view.flush(out);
+
+        REQUIRE( out.empty() );
+        REQUIRE( view.sequence() == 1 );
+    }
+
+    SECTION( "stale orderbook is refetched on resync" ) {
+        view.apply(change(2, {level("3", "2.0")}), fetch, out);
+        view.apply({.product_id = "BTC-USD", .sequence = 2, .stale = true}, fetch, out);
+
+        // pending changes are flushed before stale message
+        REQUIRE( out.size() == 2 );
+        REQUIRE( out[0].sequence == 2 );
+        REQUIRE( out[0].bids == std::vector<OrderBook::Level>{level("3", "2.0")} );
+        REQUIRE( out[1].sequence == 2 );
+        REQUIRE( out[1].stale );
+        REQUIRE( out[1].bids.empty() );
+
+        // stale message is written once
+        view.apply({.product_id = "BTC-USD", .sequence = 2, .stale = true}, fetch, out);
+
+        REQUIRE( out.size() == 2 );
+
+        SECTION( "levels of replaced orderbook are written as diff" ) {
+            fetched = OrderBook::Depth{
+                .sequence = 10,
+                .bids = {level("3", "2.0"), level("1.5", "1.0")},
+                .asks = {level("4", "1.0"), level("5", "1.0")},
+            };
+
+            view.apply({.product_id = "BTC-USD", .sequence = 2, .resync = true}, fetch, out);
+            view.flush(out);
+
+            REQUIRE( fetches == 1 );
+            REQUIRE( out.size() == 3 );
+            REQUIRE( out[2].sequence == 10 );
+            REQUIRE( out[2].bids == std::vector<OrderBook::Level>{level("1.5", "1.0"), level("2", "0", 0)} );
+            REQUIRE( out[2].asks.empty() );
+            REQUIRE( !out[2].stale );
+            REQUIRE( view.sequence() == 10 );
+
+            // changes up to sequence of fetched levels are ignored
+            view.apply(change(10, {level("3", "0", 0)}), fetch, out);
+            view.apply(change(11, {level("1.5", "3.0")}), fetch, out);
+            view.flush(out);
+
+            REQUIRE( out.size() == 4 );
+            REQUIRE( out[3].sequence == 11 );
+            REQUIRE( out[3].bids == std::vector<OrderBook::Level>{level("1.5", "3.0")} );
+        }
+
+        SECTION( "message following stale one is written even if levels did not change" ) {
+            fetched = OrderBook::Depth{
+                .sequence = 10,
+                .bids = {level("3", "2.0"), level("2", "1.0")},
+                .asks = {level("4", "1.0"), level("5", "1.0")},
+            };
+
+            view.apply({.product_id = "BTC-USD", .sequence = 2, .resync = true}, fetch, out);
+            view.flush(out);
+
+            REQUIRE( out.size() == 3 );
+            REQUIRE( out[2].sequence == 10 );
+            REQUIRE( out[2].bids.empty() );
+            REQUIRE( out[2].asks.empty() );
+            REQUIRE( !out[2].stale );
+        }
+
+        SECTION( "orderbook that became stale again is not written" ) {
+            view.apply({.product_id = "BTC-USD", .sequence = 2, .resync = true}, fetch, out);
+
+            REQUIRE( fetches == 1 );
+            REQUIRE( view.sequence() == 2 );
+
+            // stale change that follows it is not written twice
+            view.apply({.product_id = "BTC-USD", .sequence = 2, .stale = true}, fetch, out);
+            view.flush(out);
+
+            REQUIRE( out.size() == 2 );
+        }
+    }
+}
@@ -2,6 +2,8 @@
 #include <cstdlib>
 #include <future>
 #include <memory>
+#include <stdexcept>
+#include <string>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/asio/io_context.hpp>
@@ -19,6 +21,9 @@ struct Config {
     std::string rest_endpoint;
     std::string websocket_endpoint;
     std::vector<std::string> products;
+    WaitStrategy wait_strategy;
+    std::size_t apply_workers;
+    std::size_t fetch_concurrency;
 
     static Config from_env();
 };
@@ -32,7 +37,7 @@ int main() {
 
     boost::asio::io_context ioc;
     coinbase::ClientImpl client{ioc, config.rest_endpoint, config.websocket_endpoint};
-    CoinbaseSource source{logger, client, config.products};
+    CoinbaseSource source{logger, client, config.products, config.wait_strategy, config.apply_workers, config.fetch_concurrency};
     QuoteServiceImpl service(source);
 
     grpc::reflection::InitProtoReflectionServerBuilderPlugin();
@@ -55,6 +60,9 @@ Config Config::from_env() {
     auto rest_endpoint = std::getenv("QS_COINBASE_REST_ENDPOINT");
     auto websocket_endpoint = std::getenv("QS_COINBASE_WEBSOCKET_ENDPOINT");
     auto raw_products = std::getenv("QS_PRODUCTS");
+    auto raw_wait_strategy = std::getenv("QS_WAIT_STRATEGY");
+    auto raw_apply_workers = std::getenv("QS_APPLY_WORKERS");
+    auto raw_fetch_concurrency = std::getenv("QS_FETCH_CONCURRENCY");
 
     std::vector<std::string> products;
     if (raw_products != nullptr) {
@@ -63,10 +71,40 @@ Config Config::from_env() {
         products = {"BTC-USD"};
     };
 
+    auto wait_strategy = WaitStrategy::parse(raw_wait_strategy != nullptr ? raw_wait_strategy : "hybrid");
+    if (!wait_strategy) {
+        throw std::invalid_argument("invalid QS_WAIT_STRATEGY");
+    };
+
+    std::size_t apply_workers = 0;
+    if (raw_apply_workers != nullptr) {
+        try {
+            apply_workers = std::stoul(raw_apply_workers);
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("invalid QS_APPLY_WORKERS");
+        };
+    };
+
+    std::size_t fetch_concurrency = 4;
+    if (raw_fetch_concurrency != nullptr) {
+        try {
+            fetch_concurrency = std::stoul(raw_fetch_concurrency);
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("invalid QS_FETCH_CONCURRENCY");
+        };
+
+        if (fetch_concurrency == 0) {
+            throw std::invalid_argument("invalid QS_FETCH_CONCURRENCY");
+        };
+    };
+
     return Config{
         .addr = (addr != nullptr ? addr : "0.0.0.0:8080"),
         .rest_endpoint = (rest_endpoint != nullptr ? rest_endpoint : "api-public.sandbox.pro.coinbase.com"),
         .websocket_endpoint = (websocket_endpoint != nullptr ? websocket_endpoint : "ws-feed-public.sandbox.pro.coinbase.com"),
         .products = products,
+        .wait_strategy = *wait_strategy,
+        .apply_workers = apply_workers,
+        .fetch_concurrency = fetch_concurrency,
     };
 }
@@ -0,0 +1,52 @@
+#ifndef MEMORY_H
+#define MEMORY_H 1
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+// CountingResource forwards allocations to upstream resource and counts them.
+// Placed under pool resource it counts how often the pool had to go to the heap.
+class CountingResource: public std::pmr::memory_resource {
+public:
+    explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()): _upstream(upstream) {};
+
+    CountingResource(const CountingResource&) = delete;
+    CountingResource& operator=(const CountingResource&) = delete;
+
+    inline std::size_t allocations() const { return _allocations.load(std::memory_order_relaxed); };
+    inline std::size_t deallocations() const { return _deallocations.load(std::memory_order_relaxed); };
+
+    // bytes returns number of bytes currently allocated
+    inline std::size_t bytes() const { return _bytes.load(std::memory_order_relaxed); };
+
+private:
+    std::pmr::memory_resource* _upstream;
+
+    // counters are only written by owner of the resource and read by anyone
+    std::atomic<std::size_t> _allocations{0};
+    std::atomic<std::size_t> _deallocations{0};
+    std::atomic<std::size_t> _bytes{0};
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        auto p = _upstream->allocate(bytes, alignment);
+
+        _allocations.fetch_add(1, std::memory_order_relaxed);
+        _bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+        return p;
+    };
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        _upstream->deallocate(p, bytes, alignment);
+
+        _deallocations.fetch_add(1, std::memory_order_relaxed);
+        _bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    };
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    };
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "memory.h"
+
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE( "CountingResource counts allocations", "[memory]" ) {
+    CountingResource counting;
+
+    {
+        std::pmr::vector<int> v{&counting};
+        v.reserve(16);
+
+        REQUIRE( counting.allocations() == 1 );
+        REQUIRE( counting.bytes() == 16 * sizeof(int) );
+
+        v.reserve(32);
+
+        REQUIRE( counting.allocations() == 2 );
+        REQUIRE( counting.deallocations() == 1 );
+        REQUIRE( counting.bytes() == 32 * sizeof(int) );
+    }
+
+    REQUIRE( counting.deallocations() == 2 );
+    REQUIRE( counting.bytes() == 0 );
+
+    // pool keeps released blocks, so upstream is not asked again
+    std::pmr::unsynchronized_pool_resource pool{&counting};
+    std::size_t allocations = 0;
+
+    for (int i = 0; i < 100; i++) {
+        std::pmr::vector<int> v{&pool};
+        v.reserve(16);
+
+        if (i == 0) {
+            allocations = counting.allocations();
+        };
+    };
+
+    REQUIRE( counting.allocations() == allocations );
+}
@@ -0,0 +1,67 @@
+#include "order_id.h"
+
+#include <stdexcept>
+
+namespace {
+
+constexpr std::size_t uuid_length = 36;
+
+constexpr bool is_dash(std::size_t pos) {
+    return pos == 8 || pos == 13 || pos == 18 || pos == 23;
+};
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    };
+
+    throw std::invalid_argument("invalid order id");
+};
+
+} // anonymous namespace
+
+OrderId::OrderId(std::string_view src) {
+    if (src.size() != uuid_length) {
+        throw std::invalid_argument("invalid order id");
+    };
+
+    int digits = 0;
+    for (std::size_t i = 0; i < uuid_length; i++) {
+        if (is_dash(i)) {
+            if (src[i] != '-') {
+                throw std::invalid_argument("invalid order id");
+            };
+            continue;
+        };
+
+        auto& dst = digits++ < 16 ? _hi : _lo;
+        dst = dst << 4 | hex_value(src[i]);
+    };
+};
+
+std::string OrderId::str() const {
+    static constexpr char hex[] = "0123456789abcdef";
+
+    std::string dst(uuid_length, '-');
+
+    int digits = 0;
+    for (std::size_t i = 0; i < uuid_length; i++) {
+        if (is_dash(i)) {
+            continue;
+        };
+
+        auto src = digits < 16 ? _hi : _lo;
+        auto shift = 60 - 4 * (digits++ % 16);
+        dst[i] = hex[(src >> shift) & 0xf];
+    };
+
+    return dst;
+};
+
+std::ostream& operator<<(std::ostream& os, const OrderId& v) {
+    return os << v.str();
+};
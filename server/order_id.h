@@ -0,0 +1,48 @@
+#ifndef ORDER_ID_H
+#define ORDER_ID_H 1
+
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// OrderId is order UUID stored as 128-bit binary key.
+// Ids are parsed once when feed is decoded and formatted back to text only for clients.
+class OrderId {
+public:
+    constexpr OrderId() = default;
+    constexpr OrderId(std::uint64_t hi, std::uint64_t lo): _hi(hi), _lo(lo) {};
+
+    // parse UUID in canonical form ie. "de43f91d-8db9-486e-868c-8389d2611ab0"
+    // throws std::invalid_argument if id is malformed
+    OrderId(std::string_view src);
+    OrderId(const std::string& src): OrderId(std::string_view{src}) {};
+    OrderId(const char* src): OrderId(std::string_view{src}) {};
+
+    constexpr std::uint64_t hi() const { return _hi; };
+    constexpr std::uint64_t lo() const { return _lo; };
+
+    // str formats id as lowercase UUID
+    std::string str() const;
+
+    constexpr auto operator<=>(const OrderId&) const = default;
+
+private:
+    std::uint64_t _hi = 0;
+    std::uint64_t _lo = 0;
+};
+
+std::ostream& operator<<(std::ostream& os, const OrderId& v);
+
+template <>
+struct std::hash<OrderId> {
+    std::size_t operator()(const OrderId& v) const noexcept {
+        // UUID bits are mostly random, fold halves and mix so that sequential ids spread too
+        auto h = v.hi() ^ (v.lo() * 0x9e3779b97f4a7c15ull);
+        return h ^ (h >> 32);
+    };
+};
+
+#endif
@@ -0,0 +1,20 @@
+#include "order_id.h"
+
+#include <stdexcept>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE( "OrderId", "[order_id]" ) {
+    OrderId id{"de43f91d-8db9-486e-868c-8389d2611ab0"};
+
+    REQUIRE( id.hi() == 0xde43f91d8db9486eull );
+    REQUIRE( id.lo() == 0x868c8389d2611ab0ull );
+    REQUIRE( id.str() == "de43f91d-8db9-486e-868c-8389d2611ab0" );
+    REQUIRE( OrderId{"DE43F91D-8DB9-486E-868C-8389D2611AB0"} == id );
+    REQUIRE( OrderId{0, 1}.str() == "00000000-0000-0000-0000-000000000001" );
+
+    REQUIRE_THROWS_AS( OrderId{""}, std::invalid_argument );
+    REQUIRE_THROWS_AS( OrderId{"de43f91d8db9486e868c8389d2611ab0"}, std::invalid_argument );
+    REQUIRE_THROWS_AS( OrderId{"de43f91d-8db9-486e-868c-8389d2611ag0"}, std::invalid_argument );
+    REQUIRE_THROWS_AS( OrderId{"de43f91d-8db9-486e-868c+8389d2611ab0"}, std::invalid_argument );
+}
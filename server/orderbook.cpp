@@ -1,119 +1,591 @@
 #include "orderbook.h"
 
+#include <algorithm>
 #include <iostream>
-#include <boost/range/adaptor/map.hpp>
+#include <stdexcept>
+#include <string>
 
-OrderBook::OrderBook(std::int64_t sequence, Bids&& bids, Asks&& asks): _sequence{sequence}, _prices{bids.size() + asks.size()}, _bids{bids}, _asks{asks} {
-    for (const auto& entry: bids | boost::adaptors::map_values) {
-        _prices.emplace(entry.order_id, entry.price);
+namespace {
+
+// maximum number of updates buffered for stale product
+constexpr std::size_t max_pending = 1 << 20;
+
+template <typename T>
+std::vector<OrderBook::Level> top_levels(const T& entries, std::size_t n) {
+    std::vector<OrderBook::Level> dst;
+    dst.reserve(std::min(entries.levels(), n));
+
+    for (std::size_t i = 0; i < entries.levels() && dst.size() < n; i++) {
+        dst.push_back(entries.level(i));
+    };
+
+    return dst;
+};
+
+// mix is splitmix64 finalizer
+constexpr std::uint64_t mix(std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+};
+
+// level_changes appends changes of levels within level2_depth after level at price and rank was updated
+// Rank of level is the same before and after update, since only level at price changed.
+template <typename T>
+void level_changes(const T& entries, const Decimal& price, std::size_t rank, bool existed, LevelChanges& dst) {
+    if (rank >= level2_depth) {
+        return;
+    };
+
+    auto exists = rank < entries.levels() && entries.level(rank).price == price;
+
+    if (exists) {
+        dst.push_back(entries.level(rank));
+    } else if (existed) {
+        dst.push_back({.price = price, .size = Decimal{}, .count = 0});
+    };
+
+    // new level pushes the last one out of depth, removed level lets the next one in
+    if (exists && !existed && entries.levels() > level2_depth) {
+        dst.push_back({.price = entries.level(level2_depth).price, .size = Decimal{}, .count = 0});
+    } else if (!exists && existed && entries.levels() >= level2_depth) {
+        dst.push_back(entries.level(level2_depth - 1));
+    };
+};
+
+// set_entry replaces entry of order with resolved price and size, entry with zero size is removed
+template <typename T>
+void set_entry(T& entries, const OrderBook::Entry& entry) {
+    auto existing = entries.find(entry.order_id);
+
+    if (entry.size.is_zero()) {
+        if (existing) {
+            entries.erase(entry.order_id);
+        };
+    } else if (existing) {
+        entries.resize(entry.order_id, entry.size);
+    } else {
+        entries.insert(entry);
+    };
+};
+
+template <typename T>
+std::optional<OrderBook::Level> best_level(const T& entries) {
+    if (entries.levels() == 0) {
+        return std::nullopt;
     };
 
-    for (const auto& entry: asks | boost::adaptors::map_values) {
-        _prices.emplace(entry.order_id, entry.price);
+    return entries.level(0);
+};
+
+// stale_update marks orderbook of product stale at its sequence
+OrderBook::Update stale_update(const std::string& product_id, const OrderBook& orderbook) {
+    return OrderBook::Update{
+        .product_id = product_id,
+        .sequence = orderbook.sequence(),
+        .top = TopOfBook{
+            .product_id = product_id,
+            .sequence = orderbook.sequence(),
+            .stale = true,
+        },
+        .levels = Level2{
+            .product_id = product_id,
+            .sequence = orderbook.sequence(),
+            .stale = true,
+        },
+        .checksum = orderbook.checksum(),
+        .stale = true,
     };
 };
 
+} // anonymous namespace
+
+SequenceGap::SequenceGap(OrderBook::Update stale, std::int64_t received):
+    std::runtime_error("sequence gap in " + stale.product_id + " orderbook at " + std::to_string(stale.sequence) + ", received " + std::to_string(received)), stale{std::move(stale)} {
+
+};
+
+std::optional<Decimal> TopOfBook::mid() const {
+    if (!bid || !ask) {
+        return std::nullopt;
+    };
+
+    return Decimal::from_units((bid->price.units() + ask->price.units()) / 2);
+};
+
+std::optional<Decimal> TopOfBook::spread() const {
+    if (!bid || !ask) {
+        return std::nullopt;
+    };
+
+    return ask->price - bid->price;
+};
+
+
 OrderBook::OrderBook(std::int64_t sequence, std::vector<Entry> bids, std::vector<Entry> asks): OrderBook(sequence, boost::make_iterator_range(bids), boost::make_iterator_range(asks)) {
 
 };
 
+OrderBook::OrderBook(const OrderBook& other):
+    _pool{std::make_unique<Pool>()}, _sequence{other._sequence}, _bids{other._bids, &_pool->resource}, _asks{other._asks, &_pool->resource}, _checksum{other._checksum} {
+
+};
+
+std::uint64_t OrderBook::sum_checksum() const {
+    std::uint64_t sum = 0;
+
+    for (const auto& entry: _bids) {
+        sum += entry_checksum(Side::bid, entry);
+    };
+
+    for (const auto& entry: _asks) {
+        sum += entry_checksum(Side::ask, entry);
+    };
+
+    return sum;
+};
+
 template <typename T>
-OrderBook::Entry OrderBook::update(T& entries, const OrderBook::Entry& entry) {
+OrderBook::Entry OrderBook::update(T& entries, Side side, const OrderBook::Entry& entry, LevelChanges& levels) {
     auto price = entry.price;
     auto size = entry.size;
 
+    auto existing = entries.find(entry.order_id);
+
     // price is unknown, lookup by order id
     if (price.is_zero()) {
-        price = _prices.at(entry.order_id);
-    };
+        if (!existing) {
+            throw std::out_of_range("unknown order in update");
+        };
 
-    auto [begin, end] = entries.equal_range(price);
-    auto it = std::find_if(begin, end, [&entry](const auto& p) {
-        return p.second.order_id == entry.order_id;
-    });
+        price = existing->price;
+    };
 
     // requested update size with delta for order that does not exist
-    if (it == end && size.sign() == -1) {
+    if (!existing && size.sign() == -1) {
         throw std::invalid_argument("missing entry in update");
     };
 
     // update size with delta
-    if (it != end && size.sign() == -1) {
-        size = it->second.size + size;    
+    if (existing && size.sign() == -1) {
+        size = existing->size + size;
     };
 
+    // existing order stays on its level
+    auto level_price = existing ? existing->price : price;
+    auto rank = entries.rank(level_price);
+    auto existed = rank < entries.levels() && entries.level(rank).price == level_price;
+
     Entry updated{
         .order_id = entry.order_id,
         .price = price,
         .size = size,
     };
 
+    // replaced entry leaves checksum before existing is modified
+    if (existing) {
+        _checksum -= entry_checksum(side, *existing);
+    };
+
     // update exisiting entry
-    if (!size.is_zero() && it != end) {
-        it->second = updated;
+    if (!size.is_zero() && existing) {
+        entries.resize(entry.order_id, size);
+        _checksum += entry_checksum(side, *existing);
     // insert new entry
-    } else if (!size.is_zero() && it == end) {
-        entries.emplace(price, updated);
-        _prices.emplace(entry.order_id, entry.price);
+    } else if (!size.is_zero() && !existing) {
+        entries.insert(updated);
+        _checksum += entry_checksum(side, updated);
     // remove entry
-    } else if (size.is_zero() && it != end) {
-        entries.erase(it);
-        _prices.erase(entry.order_id);
+    } else if (size.is_zero() && existing) {
+        entries.erase(entry.order_id);
     };
 
+    level_changes(entries, level_price, rank, existed, levels);
+
     return updated;
 };
 
 OrderBook::Update OrderBook::update(const Update& u) {
     std::optional<Entry> bid, ask;
+    LevelChanges bid_levels, ask_levels;
+
+    // touch is compared before and after update, levels keep their aggregates so this is constant time
+    auto best_bid_before = best_bid();
+    auto best_ask_before = best_ask();
 
     if (u.bid) {
-        bid = update(_bids, u.bid.value());
+        bid = update(_bids, Side::bid, u.bid.value(), bid_levels);
     };
 
     if (u.ask) {
-        ask = update(_asks, u.ask.value());
+        ask = update(_asks, Side::ask, u.ask.value(), ask_levels);
     };
 
     _sequence = u.sequence;
 
-    return Update{
+    Update updated{
         .product_id = u.product_id,
         .sequence = u.sequence,
         .bid = bid,
         .ask = ask,
+        .checksum = _checksum,
     };
+
+    if (!bid_levels.empty() || !ask_levels.empty()) {
+        updated.levels = Level2{
+            .product_id = u.product_id,
+            .sequence = u.sequence,
+            .bids = std::move(bid_levels),
+            .asks = std::move(ask_levels),
+        };
+    };
+
+    auto best_bid_after = best_bid();
+    auto best_ask_after = best_ask();
+
+    if (best_bid_after != best_bid_before || best_ask_after != best_ask_before) {
+        updated.top = TopOfBook{
+            .product_id = u.product_id,
+            .sequence = u.sequence,
+            .bid = best_bid_after,
+            .ask = best_ask_after,
+        };
+    };
+
+    return updated;
 };
 
-OrderBooks::OrderBooks(std::unordered_map<std::string, OrderBook>&& data): _data{data} {
+void OrderBook::apply(const Update& applied) {
+    if (applied.bid) {
+        set_entry(_bids, applied.bid.value());
+    };
 
+    if (applied.ask) {
+        set_entry(_asks, applied.ask.value());
+    };
+
+    _sequence = applied.sequence;
+    _checksum = applied.checksum;
+};
+
+std::optional<OrderBook::Level> OrderBook::best_bid() const {
+    return best_level(_bids);
+};
+
+std::optional<OrderBook::Level> OrderBook::best_ask() const {
+    return best_level(_asks);
+};
+
+OrderBook::Depth OrderBook::depth(std::size_t n) const {
+    return Depth{
+        .sequence = _sequence,
+        .bids = top_levels(_bids, n),
+        .asks = top_levels(_asks, n),
+    };
+};
+
+OrderBooks::OrderBooks(std::unordered_map<std::string, OrderBook>&& data) {
+    for (auto& [product_id, orderbook]: data) {
+        _shards.emplace(product_id, std::make_unique<Shard>(std::move(orderbook)));
+    };
 };
 
-bool OrderBooks::get(std::string product_id, std::function<void (const OrderBook&)> callback) {
-    auto lock = std::shared_lock(_mtx);
+OrderBooks::Shard* OrderBooks::find(const std::string& product_id) {
+    auto it = _shards.find(product_id);
+    return it != _shards.end() ? it->second.get() : nullptr;
+};
 
-    auto it = _data.find(product_id);
-    if (it == _data.end()) {
-        return false;
+std::shared_ptr<const OrderBook> OrderBooks::snapshot(const std::string& product_id) {
+    auto shard = find(product_id);
+    if (shard == nullptr) {
+        return nullptr;
     }
-    
-    callback(it->second);
 
-    return true;
+    // concurrent readers wait for single copy instead of making their own
+    auto snapshot_lock = std::unique_lock(shard->snapshot_mtx);
+
+    std::shared_ptr<const OrderBook> replica;
+    std::vector<OrderBook::Update> log;
+    {
+        // cached snapshot is only written by readers holding snapshot_mtx or by reset holding exclusive lock
+        auto lock = std::shared_lock(shard->mtx);
+        if (shard->state == State::stale) {
+            return nullptr;
+        };
+
+        auto snapshot = shard->snapshot.lock();
+        if (snapshot && snapshot->sequence() == shard->orderbook->sequence()) {
+            return snapshot;
+        };
+
+        // replica is not updated until copying is cleared, log has updates it is missing
+        shard->copying = true;
+        replica = shard->replica;
+        log = shard->log;
+    }
+
+    auto snapshot = std::make_shared<OrderBook>(*replica);
+    shard->copying.store(false, std::memory_order_release);
+
+    for (const auto& applied: log) {
+        snapshot->apply(applied);
+    };
+
+    _snapshot_allocations.fetch_add(snapshot->allocations(), std::memory_order_relaxed);
+
+    // orderbook that was reset meanwhile is not cached
+    auto lock = std::shared_lock(shard->mtx);
+    if (shard->replica == replica) {
+        shard->snapshot = snapshot;
+    };
+
+    return snapshot;
+};
+
+std::optional<OrderBook::Depth> OrderBooks::depth(const std::string& product_id, std::size_t n) {
+    auto shard = find(product_id);
+    if (shard == nullptr) {
+        return std::nullopt;
+    }
+
+    auto lock = std::shared_lock(shard->mtx);
+    if (shard->state == State::stale) {
+        return std::nullopt;
+    };
+
+    return shard->orderbook->depth(n);
+};
+
+std::optional<TopOfBook> OrderBooks::top(const std::string& product_id) {
+    auto shard = find(product_id);
+    if (shard == nullptr) {
+        return std::nullopt;
+    }
+
+    auto lock = std::shared_lock(shard->mtx);
+    if (shard->state == State::stale) {
+        return std::nullopt;
+    };
+
+    return TopOfBook{
+        .product_id = product_id,
+        .sequence = shard->orderbook->sequence(),
+        .bid = shard->orderbook->best_bid(),
+        .ask = shard->orderbook->best_ask(),
+    };
 };
 
 std::optional<OrderBook::Update> OrderBooks::update(const OrderBook::Update& update) {
-    auto lock = std::unique_lock(_mtx);
+    auto shard = find(update.product_id);
+    if (shard == nullptr) {
+        throw std::out_of_range("unknown product in update");
+    };
+
+    auto lock = std::unique_lock(shard->mtx);
 
-    auto& orderbook = _data.at(update.product_id);
+    if (shard->state != State::live) {
+        // buffer is dropped if product stays stale for too long, reset then waits for orderbook that is newer
+        if (shard->pending.size() >= max_pending) {
+            shard->dropped += shard->pending.size();
+            shard->pending.clear();
+        };
+
+        shard->pending.push_back(update);
+        return std::nullopt;
+    };
+
+    auto& orderbook = *shard->orderbook;
 
     if (update.sequence <= orderbook.sequence()) {
         return std::nullopt;
     };
 
     if (update.sequence - orderbook.sequence() > 1) {
-        throw std::invalid_argument("invalid sequence");
+        shard->state = State::stale;
+        shard->pending.push_back(update);
+
+        throw SequenceGap(stale_update(update.product_id, orderbook), update.sequence);
     }
 
-    return orderbook.update(update);
-};
\ No newline at end of file
+    return apply(*shard, update);
+};
+
+std::optional<OrderBook::Update> OrderBooks::reset(const std::string& product_id, OrderBook&& orderbook) {
+    auto shard = find(product_id);
+    if (shard == nullptr) {
+        throw std::out_of_range("unknown product in reset");
+    };
+
+    auto lock = std::unique_lock(shard->mtx);
+
+    shard->orderbook.emplace(std::move(orderbook));
+    shard->log.clear();
+    shard->snapshot.reset();
+
+    auto& current = *shard->orderbook;
+    auto& pending = shard->pending;
+
+    auto it = pending.begin();
+    for (; it != pending.end(); it++) {
+        if (it->sequence <= current.sequence()) {
+            continue;
+        };
+
+        if (it->sequence - current.sequence() > 1) {
+            break;
+        };
+
+        current.update(*it);
+    };
+
+    pending.erase(pending.begin(), it);
+
+    // orderbook is older than buffered updates
+    if (!pending.empty()) {
+        shard->state = State::stale;
+        return std::nullopt;
+    };
+
+    // snapshot being copied keeps the previous replica
+    shard->replica = std::make_shared<OrderBook>(current);
+    shard->state = State::resync;
+
+    return OrderBook::Update{
+        .product_id = product_id,
+        .sequence = current.sequence(),
+        .top = TopOfBook{
+            .product_id = product_id,
+            .sequence = current.sequence(),
+            .bid = current.best_bid(),
+            .ask = current.best_ask(),
+        },
+        .levels = Level2{
+            .product_id = product_id,
+            .sequence = current.sequence(),
+            .resync = true,
+        },
+        .checksum = current.checksum(),
+        .resync = true,
+    };
+};
+
+std::vector<OrderBook::Update> OrderBooks::resume(const std::string& product_id) {
+    auto shard = find(product_id);
+    if (shard == nullptr) {
+        throw std::out_of_range("unknown product in resume");
+    };
+
+    auto lock = std::unique_lock(shard->mtx);
+
+    if (shard->state == State::stale) {
+        throw std::logic_error("resume of stale orderbook");
+    };
+
+    auto& orderbook = *shard->orderbook;
+    auto& pending = shard->pending;
+
+    std::vector<OrderBook::Update> applied;
+
+    auto it = pending.begin();
+    for (; it != pending.end(); it++) {
+        if (it->sequence <= orderbook.sequence()) {
+            continue;
+        };
+
+        if (it->sequence - orderbook.sequence() > 1) {
+            break;
+        };
+
+        applied.push_back(apply(*shard, *it));
+    };
+
+    pending.erase(pending.begin(), it);
+
+    // updates before gap are returned first, gap is reported by the next call
+    if (applied.empty() && !pending.empty()) {
+        shard->state = State::stale;
+        throw SequenceGap(stale_update(product_id, orderbook), pending.front().sequence);
+    };
+
+    if (pending.empty() && applied.empty()) {
+        shard->state = State::live;
+    };
+
+    return applied;
+};
+
+OrderBook::Update OrderBooks::apply(Shard& shard, const OrderBook::Update& update) {
+    auto res = shard.orderbook->update(update);
+
+    // replica only needs resolved entries and checksum, levels and top of book are not logged
+    if (shard.copying.load(std::memory_order_acquire)) {
+        shard.log.push_back({
+            .sequence = res.sequence,
+            .bid = res.bid,
+            .ask = res.ask,
+            .checksum = res.checksum,
+        });
+        return res;
+    };
+
+    for (const auto& logged: shard.log) {
+        shard.replica->apply(logged);
+    };
+    shard.log.clear();
+
+    shard.replica->apply(res);
+
+    return res;
+};
+
+std::size_t OrderBooks::dropped(const std::string& product_id) {
+    auto shard = find(product_id);
+    if (shard == nullptr) {
+        return 0;
+    };
+
+    auto lock = std::shared_lock(shard->mtx);
+
+    return shard->dropped;
+};
+
+std::size_t OrderBooks::allocations() {
+    std::size_t n = _snapshot_allocations.load(std::memory_order_relaxed);
+    for (const auto& [_, shard]: _shards) {
+        auto lock = std::shared_lock(shard->mtx);
+        n += shard->orderbook->allocations() + shard->replica->allocations();
+    };
+
+    return n;
+};
+
+std::uint64_t entry_checksum(Side side, const OrderBook::Entry& entry) {
+    auto h = mix(side == Side::bid ? 1 : 2);
+    h = mix(h ^ entry.order_id.hi());
+    h = mix(h ^ entry.order_id.lo());
+    h = mix(h ^ static_cast<std::uint64_t>(entry.price.units()));
+    return mix(h ^ static_cast<std::uint64_t>(entry.size.units()));
+};
+
+std::vector<OrderBook::Level> diff_levels(const std::vector<OrderBook::Level>& from, const std::vector<OrderBook::Level>& to) {
+    std::vector<OrderBook::Level> dst;
+
+    auto find = [](const auto& levels, const auto& price) {
+        return std::find_if(levels.begin(), levels.end(), [&price](const auto& level) { return level.price == price; });
+    };
+
+    for (const auto& level: to) {
+        auto it = find(from, level.price);
+        if (it == from.end() || *it != level) {
+            dst.push_back(level);
+        };
+    };
+
+    for (const auto& level: from) {
+        if (find(to, level.price) == to.end()) {
+            dst.push_back({.price = level.price, .size = Decimal{}, .count = 0});
+        };
+    };
+
+    return dst;
+};
@@ -1,22 +1,72 @@
+#ifndef ORDERBOOK_H
+#define ORDERBOOK_H 1
+
+#include <atomic>
 #include <cstdint>
-#include <map>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
 #include <unordered_map>
 #include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
+#include <boost/container/static_vector.hpp>
 #include <boost/range/iterator_range.hpp>
 
 #include "decimal.h"
+#include "ladder.h"
+#include "memory.h"
+#include "order_id.h"
 
 enum class Side {
     bid,
     ask
 };
 
+// TopOfBook is best bid and ask of product with size at the touch
+struct TopOfBook {
+    std::string product_id;
+    std::int64_t sequence;
+    std::optional<PriceLevel> bid;
+    std::optional<PriceLevel> ask;
+
+    // stale is set without bid and ask when updates of product were lost, until top of resynced orderbook follows
+    bool stale = false;
+
+    // mid returns price between the best bid and ask, truncated to Decimal precision
+    std::optional<Decimal> mid() const;
+    std::optional<Decimal> spread() const;
+};
+
+// level2_depth is number of the best price levels of each side whose changes are reported by update
+constexpr std::size_t level2_depth = 1000;
+
+// LevelChanges holds changed levels of one side
+// Update of single entry changes its level and the one pushed out of or let into depth, so they are held inline without allocation.
+using LevelChanges = boost::container::static_vector<PriceLevel, 2>;
+
+// Level2 contains price levels of product that changed within level2_depth best ones
+// Level with zero size and count was removed or fell out of depth, level that entered depth carries its whole size.
+struct Level2 {
+    std::string product_id;
+    std::int64_t sequence;
+    LevelChanges bids;
+    LevelChanges asks;
+
+    // stale is set without levels when updates of product were lost
+    bool stale = false;
+    // resync is set without levels when orderbook was replaced, its levels have to be read again
+    bool resync = false;
+};
+
 class OrderBook {
 public:
     struct Entry {
-        std::string order_id;
+        OrderId order_id;
         Decimal price;
         Decimal size;
 
@@ -29,24 +79,63 @@ public:
         std::optional<Entry> bid;
         std::optional<Entry> ask;
 
+        // top is set by update if it changed best bid or ask
+        std::optional<TopOfBook> top;
+        // levels are set by update if it changed any level within level2_depth
+        std::optional<Level2> levels;
+
+        // checksum of orderbook after update, set by update
+        std::uint64_t checksum = 0;
+
+        // stale is set on update without entries at the last applied sequence when the following updates were lost
+        bool stale = false;
+        // resync is set on update without entries that replaced orderbook after updates were lost
+        bool resync = false;
+
         constexpr bool empty() const {
             return bid.has_value() && ask.has_value();
         };
     };
 
-    using Bids = std::multimap<Decimal, Entry, std::greater<Decimal>>;
-    using Asks = std::multimap<Decimal, Entry, std::less<Decimal>>;
+    // Level aggregates entries with the same price
+    using Level = PriceLevel;
+
+    // Depth contains best levels of orderbook at sequence
+    struct Depth {
+        std::int64_t sequence;
+        std::vector<Level> bids;
+        std::vector<Level> asks;
+    };
+
+    using Bids = Ladder<Entry, std::greater<Decimal>>;
+    using Asks = Ladder<Entry, std::less<Decimal>>;
 
-    OrderBook(std::int64_t sequence, Bids&& bids, Asks&& asks);
     OrderBook(std::int64_t sequence, std::vector<Entry> bids, std::vector<Entry> asks);
 
     template <typename BidsIterT, typename AsksIterT>
     OrderBook(std::int64_t sequence, boost::iterator_range<BidsIterT> bids, boost::iterator_range<AsksIterT> asks);
 
+    // copy allocates its own pool
+    OrderBook(const OrderBook& other);
+    OrderBook(OrderBook&&) = default;
+
+    OrderBook& operator=(const OrderBook&) = delete;
+    OrderBook& operator=(OrderBook&&) = delete;
+
     inline std::int64_t sequence() const { return _sequence; }
     inline const Bids& bids() const { return _bids; }
     inline const Asks& asks() const { return _asks; }
 
+    // checksum is sum of entry_checksum of all entries modulo 2^64, so that update maintains it in constant time
+    inline std::uint64_t checksum() const { return _checksum; }
+
+    // depth returns up to n best levels of each side
+    Depth depth(std::size_t n) const;
+
+    // best_bid and best_ask return level at the touch or nothing if side is empty
+    std::optional<Level> best_bid() const;
+    std::optional<Level> best_ask() const;
+
     // update performs atomic update bids and asks
     // return value contains update orderbook sequence and actual price and size of entry
     //
@@ -55,26 +144,123 @@ public:
     // if entry.size < 0 then entry size will be reduced
     Update update(const Update& update);
 
+    // apply sets entries of update returned by update of orderbook with the same entries
+    // Levels and top of book are not derived and checksum is taken from update,
+    // so that copy of orderbook is kept in sync at fraction of update cost.
+    void apply(const Update& applied);
+
+    // allocations returns number of heap allocations made by orderbook pool
+    // It only grows while orderbook is larger than it ever was, steady churn of orders is served by the pool.
+    inline std::size_t allocations() const { return _pool->upstream.allocations(); }
+
 private:
+    // Pool backs containers of both sides so that memory released by cancelled orders is reused by new ones.
+    // It is held by pointer so that ladders keep valid resource when orderbook is moved.
+    struct Pool {
+        CountingResource upstream;
+        std::pmr::unsynchronized_pool_resource resource{&upstream};
+    };
+
+    std::unique_ptr<Pool> _pool;
     std::int64_t _sequence;
-    std::unordered_map<std::string, Decimal> _prices;
     Bids _bids;
     Asks _asks;
 
+    std::uint64_t _checksum = 0;
+
+    // levels receives changes of levels within level2_depth
     template <typename T>
-    OrderBook::Entry update(T& entries, const Entry& entry);
+    OrderBook::Entry update(T& entries, Side side, const Entry& entry, LevelChanges& levels);
+
+    std::uint64_t sum_checksum() const;
+};
+
+// SequenceGap is thrown when updates of product were lost
+// It carries stale update, with stale top of book, to be published before product is resynced.
+class SequenceGap: public std::runtime_error {
+public:
+    SequenceGap(OrderBook::Update stale, std::int64_t received);
+
+    OrderBook::Update stale;
 };
 
+// OrderBooks is sharded per product, each orderbook has its own lock
+// so that reading or updating one product never waits for another one.
+// Product with lost updates is stale until it is reset with fresh orderbook, other products are not affected.
 class OrderBooks {
 public:
     explicit OrderBooks(std::unordered_map<std::string, OrderBook>&& data);
 
-    bool get(std::string product_id, std::function<void (const OrderBook&)> callback);
+    // snapshot returns immutable copy of orderbook tagged with its sequence, or nullptr if product is unknown or stale
+    // Copy is made by the first reader after each update and shared with readers of the same sequence.
+    // It is copied from replica without lock of orderbook, so the update thread never waits for the copy.
+    std::shared_ptr<const OrderBook> snapshot(const std::string& product_id);
+    // depth and top return nothing if product is unknown or stale
+    std::optional<OrderBook::Depth> depth(const std::string& product_id, std::size_t n);
+    std::optional<TopOfBook> top(const std::string& product_id);
+
+    // update applies update to orderbook of its product, nothing is returned if it is already applied
+    // Update that skips sequence marks product stale and throws SequenceGap,
+    // updates of stale product are buffered and nothing is returned until it is reset and resumed.
     std::optional<OrderBook::Update> update(const OrderBook::Update& update);
 
+    // reset replaces orderbook of stale product and applies buffered updates after its sequence
+    // Returns resync update with sequence, checksum and top of book of the new orderbook,
+    // or nothing if buffered updates do not continue from it and product stays stale.
+    // Updates are still buffered after reset, so that resync is published before them.
+    std::optional<OrderBook::Update> reset(const std::string& product_id, OrderBook&& orderbook);
+
+    // resume applies updates buffered since reset and returns them
+    // Empty result means that product is live again and following updates are applied by update.
+    // Throws SequenceGap and product becomes stale again if buffered updates skip sequence.
+    std::vector<OrderBook::Update> resume(const std::string& product_id);
+
+    // dropped returns number of updates of product that were dropped because too many of them were buffered while it was stale
+    std::size_t dropped(const std::string& product_id);
+
+    // allocations returns number of heap allocations made by pools of orderbooks, their replicas and snapshots
+    std::size_t allocations();
+
 private:
-    std::shared_mutex _mtx;
-    std::unordered_map<std::string, OrderBook> _data;
+    enum class State {
+        live,
+        // waiting for reset
+        stale,
+        // reset, waiting for resume to catch up with buffered updates
+        resync,
+    };
+
+    struct Shard {
+        explicit Shard(OrderBook&& orderbook): orderbook{std::move(orderbook)}, replica{std::make_shared<OrderBook>(*this->orderbook)} {};
+
+        std::shared_mutex mtx;
+        // held as optional so that reset can replace it in place
+        std::optional<OrderBook> orderbook;
+
+        // replica is second copy of orderbook that snapshots are copied from
+        // Update thread applies entries of updates to it as well, except while it is copied, then they are logged and applied afterwards.
+        std::shared_ptr<OrderBook> replica;
+        std::vector<OrderBook::Update> log;
+        std::atomic<bool> copying{false};
+
+        State state = State::live;
+        // updates received while product is not live
+        std::vector<OrderBook::Update> pending;
+        std::size_t dropped = 0;
+
+        // the latest snapshot while any reader holds it, snapshot_mtx serializes readers that copy it
+        std::mutex snapshot_mtx;
+        std::weak_ptr<const OrderBook> snapshot;
+    };
+
+    // set of products is fixed on construction, so shards are looked up without lock
+    std::unordered_map<std::string, std::unique_ptr<Shard>> _shards;
+
+    // allocations made by pools of snapshots that were copied
+    std::atomic<std::size_t> _snapshot_allocations{0};
+
+    Shard* find(const std::string& product_id);
+    static OrderBook::Update apply(Shard& shard, const OrderBook::Update& update);
 };
 
 constexpr Side opposite(Side side) {
@@ -86,18 +272,25 @@ constexpr Side opposite(Side side) {
     };    
 };
 
-template <typename T, typename IterT>
-T map_entries(boost::iterator_range<IterT> src) {
-    T dst;
+// entry_checksum hashes side, order id, price and size of entry
+// Clients can reproduce it from streamed entries, see OrderBook message in api/quote.proto.
+std::uint64_t entry_checksum(Side side, const OrderBook::Entry& entry);
 
-    for (auto const& entry: src) {
-        dst.emplace(entry.price, entry);
-    }
+// diff_levels returns levels of to that differ from from
+// levels that are only in from are returned with zero size and count
+std::vector<OrderBook::Level> diff_levels(const std::vector<OrderBook::Level>& from, const std::vector<OrderBook::Level>& to);
 
-    return dst;
-}
+// is_new returns true if message follows sequence
+// Stale message repeats the last applied sequence, so it also follows messages up to that sequence.
+template <typename T>
+bool is_new(const T& value, std::int64_t sequence) {
+    return value.sequence > sequence || (value.stale && value.sequence == sequence);
+};
 
 template <typename BidsIterT, typename AsksIterT>
-OrderBook::OrderBook(std::int64_t sequence, boost::iterator_range<BidsIterT> bids, boost::iterator_range<AsksIterT> asks): OrderBook(sequence, map_entries<Bids, BidsIterT>(bids), map_entries<Asks, AsksIterT>(asks)) {
+OrderBook::OrderBook(std::int64_t sequence, boost::iterator_range<BidsIterT> bids, boost::iterator_range<AsksIterT> asks):
+    _pool{std::make_unique<Pool>()}, _sequence{sequence}, _bids{bids, &_pool->resource}, _asks{asks, &_pool->resource}, _checksum{sum_checksum()} {
 
 };
+
+#endif
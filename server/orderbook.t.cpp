@@ -1,17 +1,121 @@
 #include "orderbook.h"
 
-#include <boost/range/adaptor/map.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <new>
+
 #include <boost/range/algorithm/equal.hpp>
 
 #include <catch2/catch.hpp>
 
 namespace {
+    // heap allocations made by current thread, counted by operator new replaced below
+    thread_local std::size_t thread_allocations = 0;
+
+    // allocate calls new handler until alloc succeeds or there is no handler
+    template <typename F>
+    void* allocate(F alloc) noexcept {
+        thread_allocations++;
+
+        while (true) {
+            if (auto p = alloc()) {
+                return p;
+            };
+
+            auto handler = std::get_new_handler();
+            if (handler == nullptr) {
+                return nullptr;
+            };
+
+            try {
+                handler();
+            } catch (...) {
+                return nullptr;
+            };
+        };
+    };
+
+    void* allocate(std::size_t size) noexcept {
+        return allocate([size] { return std::malloc(size != 0 ? size : 1); });
+    };
+
+    void* allocate(std::size_t size, std::align_val_t alignment) noexcept {
+        // aligned_alloc requires size that is multiple of alignment
+        auto align = static_cast<std::size_t>(alignment);
+        auto rounded = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+
+        return allocate([align, rounded] { return std::aligned_alloc(align, rounded); });
+    };
+
+    // AllocationScope counts heap allocations made by current thread since it was created
+    class AllocationScope {
+    public:
+        AllocationScope(): _start(thread_allocations) {};
+
+        inline std::size_t allocations() const { return thread_allocations - _start; };
+
+    private:
+        std::size_t _start;
+    };
+
     template <typename T>
     bool entries_equal(const T& entries, std::vector<OrderBook::Entry> expected) {
-        return boost::range::equal(boost::adaptors::values(entries), expected);
+        return boost::range::equal(entries, expected);
     };
 } // anonymous namespace
 
+// operator new is replaced in test binary only, array forms forward to these, so they are counted as well
+
+void* operator new(std::size_t size) {
+    if (auto p = allocate(size)) {
+        return p;
+    };
+
+    throw std::bad_alloc();
+};
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+};
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (auto p = allocate(size, alignment)) {
+        return p;
+    };
+
+    throw std::bad_alloc();
+};
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, alignment);
+};
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+};
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+};
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+};
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+};
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+};
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(p);
+};
+
 TEST_CASE( "OrderBook update", "[orderbook]" ) {
     std::vector<OrderBook::Entry> bids{
         {.order_id = "de43f91d-8db9-486e-868c-8389d2611ab0", .price = Decimal{"2.0"}, .size = Decimal{"1.0"}},
@@ -80,4 +184,592 @@ TEST_CASE( "OrderBook update", "[orderbook]" ) {
         {.order_id = "b37c144f-ad9c-4490-9228-b80766829dcc", .price = Decimal{"2.1"}, .size = Decimal{"1.0"}},
         {.order_id = "09d86b54-7e8f-46d0-b425-151f24914c36", .price = Decimal{"3.0"}, .size = Decimal{"1.0"}},
     }) );
-}
\ No newline at end of file
+}
+
+TEST_CASE( "OrderBook levels", "[orderbook]" ) {
+    OrderBook orderbook{0, std::vector<OrderBook::Entry>{
+        {.order_id = "de43f91d-8db9-486e-868c-8389d2611ab0", .price = Decimal{"2.0"}, .size = Decimal{"1.0"}},
+        {.order_id = "77c7c96d-f171-4695-831f-de3c8f6ed2d7", .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+        {.order_id = "dd3c42ec-2fcd-4069-881b-667d64714e79", .price = Decimal{"1.0"}, .size = Decimal{"2.0"}},
+    }, std::vector<OrderBook::Entry>{
+        {.order_id = "e68b5cb3-5d97-4085-9078-1d95995ad8ce", .price = Decimal{"2.1"}, .size = Decimal{"1.0"}},
+    }};
+
+    auto depth = orderbook.depth(2);
+
+    REQUIRE( depth.bids == std::vector<OrderBook::Level>{
+        {.price = Decimal{"2.0"}, .size = Decimal{"1.0"}, .count = 1},
+        {.price = Decimal{"1.0"}, .size = Decimal{"3.0"}, .count = 2},
+    } );
+    REQUIRE( depth.asks == std::vector<OrderBook::Level>{
+        {.price = Decimal{"2.1"}, .size = Decimal{"1.0"}, .count = 1},
+    } );
+
+    // update size, remove order and insert order
+    orderbook.update({
+        .sequence = 1,
+        .bid{{.order_id = "dd3c42ec-2fcd-4069-881b-667d64714e79", .size = Decimal{"-0.5"}}},
+    });
+    orderbook.update({
+        .sequence = 2,
+        .bid{{.order_id = "de43f91d-8db9-486e-868c-8389d2611ab0", .price = Decimal{"2.0"}, .size = Decimal{"0.0"}}},
+        .ask{{.order_id = "09d86b54-7e8f-46d0-b425-151f24914c36", .price = Decimal{"2.1"}, .size = Decimal{"0.5"}}},
+    });
+
+    auto next = orderbook.depth(2);
+
+    REQUIRE( next.sequence == 2 );
+    REQUIRE( next.bids == std::vector<OrderBook::Level>{
+        {.price = Decimal{"1.0"}, .size = Decimal{"2.5"}, .count = 2},
+    } );
+    REQUIRE( next.asks == std::vector<OrderBook::Level>{
+        {.price = Decimal{"2.1"}, .size = Decimal{"1.5"}, .count = 2},
+    } );
+
+    // removed level is reported with zero size
+    REQUIRE( diff_levels(depth.bids, next.bids) == std::vector<OrderBook::Level>{
+        {.price = Decimal{"1.0"}, .size = Decimal{"2.5"}, .count = 2},
+        {.price = Decimal{"2.0"}, .size = Decimal{"0"}, .count = 0},
+    } );
+    REQUIRE( diff_levels(next.bids, next.bids).empty() );
+}
+
+TEST_CASE( "OrderBook update reports changed levels within depth", "[orderbook]" ) {
+    // bids fill level2_depth levels priced from 1 to level2_depth
+    std::vector<OrderBook::Entry> bids;
+    for (std::uint64_t i = 1; i <= level2_depth; i++) {
+        bids.push_back({.order_id = OrderId{0, i}, .price = Decimal{std::to_string(i)}, .size = Decimal{"1.0"}});
+    };
+
+    OrderBook orderbook{0, bids, std::vector<OrderBook::Entry>{}};
+
+    SECTION( "changed level carries its size" ) {
+        auto update = orderbook.update({
+            .sequence = 1,
+            .bid{{.order_id = OrderId{1, 1}, .price = Decimal{"1000"}, .size = Decimal{"2.0"}}},
+        });
+
+        REQUIRE( update.levels->sequence == 1 );
+        REQUIRE( update.levels->bids == LevelChanges{
+            {.price = Decimal{"1000"}, .size = Decimal{"3.0"}, .count = 2},
+        } );
+        REQUIRE( update.levels->asks.empty() );
+    }
+
+    SECTION( "new level pushes the last one out of depth" ) {
+        auto update = orderbook.update({
+            .sequence = 1,
+            .bid{{.order_id = OrderId{1, 1}, .price = Decimal{"1000.5"}, .size = Decimal{"2.0"}}},
+        });
+
+        REQUIRE( update.levels->bids == LevelChanges{
+            {.price = Decimal{"1000.5"}, .size = Decimal{"2.0"}, .count = 1},
+            {.price = Decimal{"1"}, .size = Decimal{}, .count = 0},
+        } );
+
+        // level out of depth is not reported
+        REQUIRE( !orderbook.update({
+            .sequence = 2,
+            .bid{{.order_id = OrderId{0, 1}, .price = Decimal{"1"}, .size = Decimal{"0"}}},
+        }).levels );
+    }
+
+    SECTION( "removed level lets the next one in" ) {
+        REQUIRE( !orderbook.update({
+            .sequence = 1,
+            .bid{{.order_id = OrderId{1, 1}, .price = Decimal{"0.5"}, .size = Decimal{"2.0"}}},
+        }).levels );
+
+        auto update = orderbook.update({
+            .sequence = 2,
+            .bid{{.order_id = OrderId{0, level2_depth}, .price = Decimal{"1000"}, .size = Decimal{"0"}}},
+        });
+
+        REQUIRE( update.levels->bids == LevelChanges{
+            {.price = Decimal{"1000"}, .size = Decimal{}, .count = 0},
+            {.price = Decimal{"0.5"}, .size = Decimal{"2.0"}, .count = 1},
+        } );
+    }
+}
+
+TEST_CASE( "OrderBook reuses memory of removed orders", "[orderbook]" ) {
+    constexpr int count = 1000;
+
+    std::vector<OrderBook::Entry> bids;
+    for (int i = 0; i < count; i++) {
+        bids.push_back({.order_id = OrderId{1, static_cast<std::uint64_t>(i)}, .price = Decimal::from_units(100000000 + i % 100 * 1000000), .size = Decimal{"1.0"}});
+    };
+
+    OrderBook orderbook{0, bids, std::vector<OrderBook::Entry>{}};
+
+    // every round cancels all orders and places the same number of new ones at shifted prices
+    std::int64_t sequence = 0;
+    auto churn = [&](std::uint64_t round) {
+        for (int i = 0; i < count; i++) {
+            orderbook.update({.sequence = ++sequence, .bid{{.order_id = OrderId{round, static_cast<std::uint64_t>(i)}, .price = Decimal{}, .size = Decimal{}}}});
+            orderbook.update({.sequence = ++sequence, .bid{{.order_id = OrderId{round + 1, static_cast<std::uint64_t>(i)}, .price = Decimal::from_units(100000000 + (i + round) % 100 * 1000000), .size = Decimal{"1.0"}}}});
+        };
+    };
+
+    churn(1);
+    auto allocations = orderbook.allocations();
+
+    for (std::uint64_t round = 2; round < 10; round++) {
+        churn(round);
+    };
+
+    REQUIRE( orderbook.bids().size() == count );
+    REQUIRE( orderbook.bids().levels() == 100 );
+    REQUIRE( orderbook.allocations() == allocations );
+
+    // copy gets its own pool
+    OrderBook copy{orderbook};
+    REQUIRE( std::equal(copy.bids().begin(), copy.bids().end(), orderbook.bids().begin(), orderbook.bids().end()) );
+
+    copy.update({.sequence = ++sequence, .bid{{.order_id = OrderId{10, 0}, .price = Decimal{}, .size = Decimal{}}}});
+    REQUIRE( copy.bids().size() == count - 1 );
+    REQUIRE( orderbook.bids().size() == count );
+}
+
+TEST_CASE( "OrderBook update benchmark", "[!benchmark][orderbook]" ) {
+    constexpr int count = 10000;
+
+    std::vector<OrderBook::Entry> bids, asks;
+    for (int i = 0; i < count; i++) {
+        bids.push_back({.order_id = OrderId{1, static_cast<std::uint64_t>(i)}, .price = Decimal::from_units(3600000000000 - i % 500 * 1000000), .size = Decimal{"1.0"}});
+        asks.push_back({.order_id = OrderId{2, static_cast<std::uint64_t>(i)}, .price = Decimal::from_units(3610000000000 + i % 500 * 1000000), .size = Decimal{"1.0"}});
+    };
+
+    // every iteration reduces size of each bid by delta, then restores it
+    BENCHMARK_ADVANCED( "reduce and restore entries" )(Catch::Benchmark::Chronometer meter) {
+        OrderBook orderbook{0, bids, asks};
+
+        meter.measure([&] {
+            std::int64_t sequence = orderbook.sequence();
+            for (const auto& entry: bids) {
+                orderbook.update({.sequence = ++sequence, .bid{{.order_id = entry.order_id, .size = Decimal{"-0.5"}}}});
+                orderbook.update({.sequence = ++sequence, .bid{{.order_id = entry.order_id, .price = entry.price, .size = entry.size}}});
+            };
+            return sequence;
+        });
+    };
+}
+
+TEST_CASE( "OrderBook apply keeps copy in sync", "[orderbook]" ) {
+    OrderBook orderbook{0, std::vector<OrderBook::Entry>{
+        {.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+        {.order_id = OrderId{0, 2}, .price = Decimal{"0.5"}, .size = Decimal{"1.0"}},
+    }, std::vector<OrderBook::Entry>{
+        {.order_id = OrderId{0, 3}, .price = Decimal{"1.5"}, .size = Decimal{"1.0"}},
+    }};
+
+    OrderBook copy{orderbook};
+
+    // update with delta, removal and insert are applied with resolved price and size
+    copy.apply(orderbook.update({.sequence = 1, .bid{{.order_id = OrderId{0, 1}, .size = Decimal{"-0.5"}}}}));
+    copy.apply(orderbook.update({.sequence = 2, .bid{{.order_id = OrderId{0, 2}, .price = Decimal{"0.5"}, .size = Decimal{"0"}}}}));
+    copy.apply(orderbook.update({.sequence = 3, .ask{{.order_id = OrderId{0, 4}, .price = Decimal{"2.0"}, .size = Decimal{"2.0"}}}}));
+    copy.apply(orderbook.update({.sequence = 4, .ask{{.order_id = OrderId{0, 3}, .size = Decimal{"0"}}}}));
+
+    REQUIRE( copy.sequence() == 4 );
+    REQUIRE( copy.checksum() == orderbook.checksum() );
+    REQUIRE( std::equal(copy.bids().begin(), copy.bids().end(), orderbook.bids().begin(), orderbook.bids().end()) );
+    REQUIRE( std::equal(copy.asks().begin(), copy.asks().end(), orderbook.asks().begin(), orderbook.asks().end()) );
+    REQUIRE( copy.depth(2).asks == orderbook.depth(2).asks );
+}
+
+TEST_CASE( "AllocationScope counts allocations of current thread", "[orderbook]" ) {
+    AllocationScope scope;
+
+    // operator new is called directly, so that allocation is not elided
+    auto p = ::operator new(16);
+    auto aligned = ::operator new(16, std::align_val_t{64});
+
+    REQUIRE( scope.allocations() == 2 );
+    REQUIRE( reinterpret_cast<std::uintptr_t>(aligned) % 64 == 0 );
+
+    ::operator delete(aligned, std::align_val_t{64});
+    ::operator delete(p);
+
+    REQUIRE( scope.allocations() == 2 );
+}
+
+TEST_CASE( "OrderBooks update makes no allocations in steady state", "[orderbook]" ) {
+    constexpr int count = 1000;
+
+    std::vector<OrderBook::Entry> bids, asks;
+    for (int i = 0; i < count; i++) {
+        bids.push_back({.order_id = OrderId{1, static_cast<std::uint64_t>(i)}, .price = Decimal::from_units(100000000 - i % 100 * 1000000), .size = Decimal{"1.0"}});
+        asks.push_back({.order_id = OrderId{0, static_cast<std::uint64_t>(i)}, .price = Decimal::from_units(200000000 + i % 100 * 1000000), .size = Decimal{"1.0"}});
+    };
+
+    std::unordered_map<std::string, OrderBook> data;
+    data.emplace("BTC-USD", OrderBook{0, bids, asks});
+    OrderBooks orderbooks{std::move(data)};
+
+    // asks are placed with order ids apart from bids, whose ids are taken from round
+    // every round cancels all bids, places new ones at shifted prices and trades with asks,
+    // so that levels are added and removed and top of book changes
+    std::int64_t sequence = 0;
+    std::size_t levels = 0, tops = 0;
+    auto churn = [&](std::uint64_t round) {
+        for (int i = 0; i < count; i++) {
+            auto bid = orderbooks.update({.product_id = "BTC-USD", .sequence = ++sequence, .bid{{.order_id = OrderId{round, static_cast<std::uint64_t>(i)}, .price = Decimal{}, .size = Decimal{}}}});
+            auto placed = orderbooks.update({.product_id = "BTC-USD", .sequence = ++sequence, .bid{{.order_id = OrderId{round + 1, static_cast<std::uint64_t>(i)}, .price = Decimal::from_units(100000000 - (i + round) % 100 * 1000000), .size = Decimal{"1.0"}}}});
+            auto traded = orderbooks.update({.product_id = "BTC-USD", .sequence = ++sequence, .ask{{.order_id = OrderId{0, static_cast<std::uint64_t>(i)}, .size = Decimal{round % 2 ? "0.5" : "1.0"}}}});
+
+            for (const auto& update: {bid, placed, traded}) {
+                levels += update->levels.has_value();
+                tops += update->top.has_value();
+            };
+        };
+    };
+
+    churn(1);
+
+    AllocationScope scope;
+    for (std::uint64_t round = 2; round < 10; round++) {
+        churn(round);
+    };
+    auto allocations = scope.allocations();
+
+    REQUIRE( levels > 0 );
+    REQUIRE( tops > 0 );
+    REQUIRE( allocations == 0 );
+}
+
+// OrderBooks update costs OrderBook update and apply of its entries to replica
+TEST_CASE( "OrderBooks update benchmark", "[!benchmark][orderbook]" ) {
+    constexpr int count = 10000;
+
+    std::vector<OrderBook::Entry> bids, asks;
+    for (int i = 0; i < count; i++) {
+        bids.push_back({.order_id = OrderId{1, static_cast<std::uint64_t>(i)}, .price = Decimal::from_units(3600000000000 - i % 500 * 1000000), .size = Decimal{"1.0"}});
+        asks.push_back({.order_id = OrderId{2, static_cast<std::uint64_t>(i)}, .price = Decimal::from_units(3610000000000 + i % 500 * 1000000), .size = Decimal{"1.0"}});
+    };
+
+    // every iteration reduces size of each bid by delta, then restores it
+    auto churn = [&bids](auto& update, std::int64_t sequence) {
+        for (const auto& entry: bids) {
+            update({.product_id = "BTC-USD", .sequence = ++sequence, .bid{{.order_id = entry.order_id, .size = Decimal{"-0.5"}}}});
+            update({.product_id = "BTC-USD", .sequence = ++sequence, .bid{{.order_id = entry.order_id, .price = entry.price, .size = entry.size}}});
+        };
+        return sequence;
+    };
+
+    BENCHMARK_ADVANCED( "orderbook update" )(Catch::Benchmark::Chronometer meter) {
+        OrderBook orderbook{0, bids, asks};
+        auto update = [&](const OrderBook::Update& u) { return orderbook.update(u); };
+
+        meter.measure([&] { return churn(update, orderbook.sequence()); });
+    };
+
+    BENCHMARK_ADVANCED( "orderbook update and apply to copy" )(Catch::Benchmark::Chronometer meter) {
+        OrderBook orderbook{0, bids, asks};
+        OrderBook copy{orderbook};
+        auto update = [&](const OrderBook::Update& u) { copy.apply(orderbook.update(u)); };
+
+        meter.measure([&] { return churn(update, orderbook.sequence()); });
+    };
+
+    BENCHMARK_ADVANCED( "orderbook update twice" )(Catch::Benchmark::Chronometer meter) {
+        OrderBook orderbook{0, bids, asks};
+        OrderBook copy{orderbook};
+        auto update = [&](const OrderBook::Update& u) { orderbook.update(u); copy.update(u); };
+
+        meter.measure([&] { return churn(update, orderbook.sequence()); });
+    };
+
+    BENCHMARK_ADVANCED( "orderbooks update" )(Catch::Benchmark::Chronometer meter) {
+        std::unordered_map<std::string, OrderBook> data;
+        data.emplace("BTC-USD", OrderBook{0, bids, asks});
+        OrderBooks orderbooks{std::move(data)};
+
+        std::int64_t sequence = 0;
+        auto update = [&](const OrderBook::Update& u) { sequence = u.sequence; return orderbooks.update(u); };
+
+        meter.measure([&] { return churn(update, sequence); });
+    };
+}
+
+TEST_CASE( "OrderBooks lock products independently", "[orderbook]" ) {
+    std::unordered_map<std::string, OrderBook> data;
+    data.emplace("BTC-USD", OrderBook{0, std::vector<OrderBook::Entry>{}, std::vector<OrderBook::Entry>{}});
+    data.emplace("ETH-USD", OrderBook{0, std::vector<OrderBook::Entry>{}, std::vector<OrderBook::Entry>{}});
+
+    OrderBooks orderbooks{std::move(data)};
+
+    auto update = orderbooks.update({
+        .product_id = "ETH-USD",
+        .sequence = 1,
+        .bid{{.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"1.0"}}},
+    });
+
+    REQUIRE( update );
+    REQUIRE( orderbooks.depth("BTC-USD", 1)->sequence == 0 );
+    REQUIRE( orderbooks.depth("ETH-USD", 1)->sequence == 1 );
+    REQUIRE( !orderbooks.depth("LTC-USD", 1) );
+    REQUIRE_THROWS_AS( orderbooks.update({.product_id = "LTC-USD", .sequence = 1}), std::out_of_range );
+}
+
+TEST_CASE( "OrderBooks snapshot", "[orderbook]" ) {
+    std::unordered_map<std::string, OrderBook> data;
+    data.emplace("BTC-USD", OrderBook{0, std::vector<OrderBook::Entry>{
+        {.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+    }, std::vector<OrderBook::Entry>{}});
+
+    OrderBooks orderbooks{std::move(data)};
+
+    auto snapshot = orderbooks.snapshot("BTC-USD");
+    REQUIRE( snapshot->sequence() == 0 );
+    REQUIRE( !orderbooks.snapshot("LTC-USD") );
+
+    // readers of the same sequence share snapshot
+    REQUIRE( orderbooks.snapshot("BTC-USD") == snapshot );
+
+    // updates continue while snapshot is held and do not change it
+    orderbooks.update({
+        .product_id = "BTC-USD",
+        .sequence = 1,
+        .bid{{.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"0"}}},
+    });
+
+    REQUIRE( snapshot->sequence() == 0 );
+    REQUIRE( snapshot->bids().size() == 1 );
+
+    auto next = orderbooks.snapshot("BTC-USD");
+    REQUIRE( next != snapshot );
+    REQUIRE( next->sequence() == 1 );
+    REQUIRE( next->bids().empty() );
+}
+
+TEST_CASE( "OrderBooks snapshot is consistent while updates are applied", "[orderbook]" ) {
+    std::unordered_map<std::string, OrderBook> data;
+    data.emplace("BTC-USD", OrderBook{0, std::vector<OrderBook::Entry>{}, std::vector<OrderBook::Entry>{}});
+
+    OrderBooks orderbooks{std::move(data)};
+
+    const std::int64_t n = 10000;
+
+    // checksum after every sequence, written by update thread and read after it is joined
+    std::vector<std::uint64_t> checksums(n + 1, 0);
+
+    auto writer = std::async(std::launch::async, [&] {
+        for (std::int64_t sequence = 1; sequence <= n; sequence++) {
+            // orders are added and every third one is removed again
+            auto remove = sequence % 3 == 0;
+            auto order = remove ? sequence - 1 : sequence;
+
+            auto update = orderbooks.update({
+                .product_id = "BTC-USD",
+                .sequence = sequence,
+                .bid{{.order_id = OrderId{0, static_cast<std::uint64_t>(order)}, .price = Decimal{order % 2 ? "1.0" : "2.0"}, .size = Decimal{remove ? "0" : "1.0"}}},
+            });
+
+            checksums[sequence] = update->checksum;
+        };
+    });
+
+    std::vector<std::shared_ptr<const OrderBook>> snapshots;
+    while (writer.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        snapshots.push_back(orderbooks.snapshot("BTC-USD"));
+    };
+    writer.get();
+
+    snapshots.push_back(orderbooks.snapshot("BTC-USD"));
+    REQUIRE( snapshots.back()->sequence() == n );
+
+    // entries of every snapshot match orderbook at its sequence
+    for (const auto& snapshot: snapshots) {
+        std::uint64_t sum = 0;
+        for (const auto& entry: snapshot->bids()) {
+            sum += entry_checksum(Side::bid, entry);
+        };
+
+        REQUIRE( sum == checksums[snapshot->sequence()] );
+    };
+}
+
+TEST_CASE( "OrderBooks sequence gap", "[orderbook]" ) {
+    std::unordered_map<std::string, OrderBook> data;
+    data.emplace("BTC-USD", OrderBook{0, std::vector<OrderBook::Entry>{
+        {.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+    }, std::vector<OrderBook::Entry>{}});
+    data.emplace("ETH-USD", OrderBook{0, std::vector<OrderBook::Entry>{}, std::vector<OrderBook::Entry>{}});
+
+    OrderBooks orderbooks{std::move(data)};
+
+    auto make_update = [](std::int64_t sequence, OrderId order_id, const char* size) {
+        return OrderBook::Update{
+            .product_id = "BTC-USD",
+            .sequence = sequence,
+            .bid{{.order_id = order_id, .price = Decimal{"1.0"}, .size = Decimal{size}}},
+        };
+    };
+
+    REQUIRE( orderbooks.update(make_update(1, OrderId{0, 2}, "1.0")) );
+
+    auto stale = orderbooks.snapshot("BTC-USD");
+
+    // update 2 was lost
+    try {
+        orderbooks.update(make_update(3, OrderId{0, 3}, "1.0"));
+        FAIL( "gap was not detected" );
+    } catch (const SequenceGap& gap) {
+        REQUIRE( gap.stale.product_id == "BTC-USD" );
+        REQUIRE( gap.stale.stale );
+        REQUIRE( gap.stale.sequence == 1 );
+        REQUIRE( gap.stale.checksum == stale->checksum() );
+        REQUIRE( gap.stale.top->stale );
+        REQUIRE( !gap.stale.top->bid );
+        REQUIRE( gap.stale.levels->stale );
+        REQUIRE( gap.stale.levels->bids.empty() );
+    };
+
+    // stale product buffers updates and is not served, other products are not affected
+    REQUIRE( !orderbooks.update(make_update(4, OrderId{0, 4}, "1.0")) );
+    REQUIRE( !orderbooks.depth("BTC-USD", 1) );
+    REQUIRE( !orderbooks.top("BTC-USD") );
+    REQUIRE( !orderbooks.snapshot("BTC-USD") );
+    REQUIRE( orderbooks.update({.product_id = "ETH-USD", .sequence = 1}) );
+
+    SECTION( "reset replays buffered updates after orderbook sequence" ) {
+        auto resync = orderbooks.reset("BTC-USD", OrderBook{3, std::vector<OrderBook::Entry>{
+            {.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+            {.order_id = OrderId{0, 2}, .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+            {.order_id = OrderId{0, 3}, .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+        }, std::vector<OrderBook::Entry>{}});
+
+        REQUIRE( resync );
+        REQUIRE( resync->resync );
+        REQUIRE( resync->sequence == 4 );
+        REQUIRE( !resync->bid );
+        REQUIRE( resync->levels->resync );
+        REQUIRE( resync->levels->sequence == 4 );
+        REQUIRE( resync->top->bid == OrderBook::Level{.price = Decimal{"1.0"}, .size = Decimal{"4.0"}, .count = 4} );
+
+        auto snapshot = orderbooks.snapshot("BTC-USD");
+        REQUIRE( snapshot != stale );
+        REQUIRE( snapshot->sequence() == 4 );
+        REQUIRE( resync->checksum == snapshot->checksum() );
+
+        // updates received after reset are applied by resume
+        REQUIRE( !orderbooks.update(make_update(5, OrderId{0, 5}, "1.0")) );
+
+        auto resumed = orderbooks.resume("BTC-USD");
+        REQUIRE( resumed.size() == 1 );
+        REQUIRE( resumed[0].sequence == 5 );
+        REQUIRE( orderbooks.resume("BTC-USD").empty() );
+
+        // product is live again
+        REQUIRE( orderbooks.update(make_update(6, OrderId{0, 6}, "1.0")) );
+        REQUIRE( orderbooks.depth("BTC-USD", 1)->sequence == 6 );
+    }
+
+    SECTION( "orderbook older than buffered updates keeps product stale" ) {
+        REQUIRE( !orderbooks.reset("BTC-USD", OrderBook{1, std::vector<OrderBook::Entry>{}, std::vector<OrderBook::Entry>{}}) );
+        REQUIRE( !orderbooks.update(make_update(5, OrderId{0, 5}, "1.0")) );
+
+        auto resync = orderbooks.reset("BTC-USD", OrderBook{2, std::vector<OrderBook::Entry>{}, std::vector<OrderBook::Entry>{}});
+        REQUIRE( resync );
+        REQUIRE( resync->sequence == 5 );
+    }
+
+    SECTION( "gap after reset" ) {
+        REQUIRE( orderbooks.reset("BTC-USD", OrderBook{4, std::vector<OrderBook::Entry>{}, std::vector<OrderBook::Entry>{}}) );
+
+        orderbooks.update(make_update(5, OrderId{0, 5}, "1.0"));
+        orderbooks.update(make_update(7, OrderId{0, 7}, "1.0"));
+
+        // updates before gap are returned first
+        REQUIRE( orderbooks.resume("BTC-USD").size() == 1 );
+        REQUIRE_THROWS_AS( orderbooks.resume("BTC-USD"), SequenceGap );
+        REQUIRE( !orderbooks.depth("BTC-USD", 1) );
+
+        auto resync = orderbooks.reset("BTC-USD", OrderBook{6, std::vector<OrderBook::Entry>{}, std::vector<OrderBook::Entry>{}});
+        REQUIRE( resync );
+        REQUIRE( resync->sequence == 7 );
+    }
+}
+
+TEST_CASE( "OrderBook top of book", "[orderbook]" ) {
+    OrderBook orderbook{0, std::vector<OrderBook::Entry>{
+        {.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+    }, std::vector<OrderBook::Entry>{}};
+
+    REQUIRE( orderbook.best_bid() == OrderBook::Level{.price = Decimal{"1.0"}, .size = Decimal{"1.0"}, .count = 1} );
+    REQUIRE( !orderbook.best_ask() );
+
+    // order away from the touch does not change top of book
+    auto u1 = orderbook.update({
+        .product_id = "BTC-USD",
+        .sequence = 1,
+        .bid{{.order_id = OrderId{0, 2}, .price = Decimal{"0.5"}, .size = Decimal{"1.0"}}},
+    });
+    REQUIRE( !u1.top );
+
+    // size at the touch does
+    auto u2 = orderbook.update({
+        .product_id = "BTC-USD",
+        .sequence = 2,
+        .bid{{.order_id = OrderId{0, 3}, .price = Decimal{"1.0"}, .size = Decimal{"2.0"}}},
+    });
+    REQUIRE( u2.top );
+    REQUIRE( u2.top->product_id == "BTC-USD" );
+    REQUIRE( u2.top->sequence == 2 );
+    REQUIRE( u2.top->bid == OrderBook::Level{.price = Decimal{"1.0"}, .size = Decimal{"3.0"}, .count = 2} );
+    REQUIRE( !u2.top->mid() );
+
+    auto u3 = orderbook.update({
+        .product_id = "BTC-USD",
+        .sequence = 3,
+        .ask{{.order_id = OrderId{0, 4}, .price = Decimal{"1.5"}, .size = Decimal{"1.0"}}},
+    });
+    REQUIRE( u3.top );
+    REQUIRE( u3.top->mid() == Decimal{"1.25"} );
+    REQUIRE( u3.top->spread() == Decimal{"0.5"} );
+}
+
+TEST_CASE( "OrderBook checksum", "[orderbook]" ) {
+    OrderBook orderbook{0, std::vector<OrderBook::Entry>{
+        {.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+        {.order_id = OrderId{0, 2}, .price = Decimal{"0.5"}, .size = Decimal{"1.0"}},
+    }, std::vector<OrderBook::Entry>{
+        {.order_id = OrderId{0, 3}, .price = Decimal{"1.5"}, .size = Decimal{"1.0"}},
+    }};
+
+    auto initial = orderbook.checksum();
+
+    REQUIRE( initial == entry_checksum(Side::bid, {.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"1.0"}})
+        + entry_checksum(Side::bid, {.order_id = OrderId{0, 2}, .price = Decimal{"0.5"}, .size = Decimal{"1.0"}})
+        + entry_checksum(Side::ask, {.order_id = OrderId{0, 3}, .price = Decimal{"1.5"}, .size = Decimal{"1.0"}}) );
+
+    // checksum depends on side
+    REQUIRE( entry_checksum(Side::bid, {.order_id = OrderId{0, 3}, .price = Decimal{"1.5"}, .size = Decimal{"1.0"}})
+        != entry_checksum(Side::ask, {.order_id = OrderId{0, 3}, .price = Decimal{"1.5"}, .size = Decimal{"1.0"}}) );
+
+    auto u1 = orderbook.update({.sequence = 1, .bid{{.order_id = OrderId{0, 1}, .size = Decimal{"-0.5"}}}});
+    auto u2 = orderbook.update({.sequence = 2, .bid{{.order_id = OrderId{0, 2}, .price = Decimal{"0.5"}, .size = Decimal{"0"}}}});
+    auto u3 = orderbook.update({.sequence = 3, .ask{{.order_id = OrderId{0, 4}, .price = Decimal{"2.0"}, .size = Decimal{"2.0"}}}});
+
+    REQUIRE( u1.checksum != initial );
+    REQUIRE( u3.checksum == orderbook.checksum() );
+
+    // checksum maintained by updates matches the one of orderbook loaded with the same entries
+    OrderBook expected{3, std::vector<OrderBook::Entry>{
+        {.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"0.5"}},
+    }, std::vector<OrderBook::Entry>{
+        {.order_id = OrderId{0, 3}, .price = Decimal{"1.5"}, .size = Decimal{"1.0"}},
+        {.order_id = OrderId{0, 4}, .price = Decimal{"2.0"}, .size = Decimal{"2.0"}},
+    }};
+
+    REQUIRE( orderbook.checksum() == expected.checksum() );
+    REQUIRE( OrderBook{orderbook}.checksum() == orderbook.checksum() );
+
+    // removing all entries returns checksum to zero
+    orderbook.update({.sequence = 4, .bid{{.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"0"}}}});
+    orderbook.update({.sequence = 5, .ask{{.order_id = OrderId{0, 3}, .price = Decimal{"1.5"}, .size = Decimal{"0"}}}});
+    orderbook.update({.sequence = 6, .ask{{.order_id = OrderId{0, 4}, .price = Decimal{"2.0"}, .size = Decimal{"0"}}}});
+
+    REQUIRE( orderbook.checksum() == 0 );
+}
@@ -0,0 +1,283 @@
+#ifndef ORDERBOOK_FEED_H
+#define ORDERBOOK_FEED_H 1
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "conflator.h"
+#include "snapshot_cache.h"
+#include "source.h"
+
+// number of buffered updates replayed to new orderbook subscriber, so that it can continue from cached snapshot
+constexpr std::size_t snapshot_replay = 256;
+
+// OrderBookFeed sequences orderbook stream of single product: snapshot followed by updates after its sequence.
+// Stream starts from cached snapshot that may be older than live orderbook, updates in between are replayed by subscription.
+// Resync update is followed by fresh snapshot, so that client replaces its orderbook.
+// Snapshots are made off the stream, feed waiting for one appends nothing and is watched on its request meanwhile.
+// Conflating feed merges updates that stream does not keep up with once it caught up with the first snapshot, see Conflator.
+// OrderBookFeed is owned by single stream, it is not synchronized.
+template <typename T>
+class OrderBookFeed {
+public:
+    using Snapshots = SnapshotCache<T>;
+
+    // Item is message to be written to stream
+    using Item = std::variant<std::shared_ptr<const typename Snapshots::Snapshot>, Message<OrderBook::Update>, Conflator::Delta>;
+
+    // RequestSnapshot requests snapshot of product that is not older than min_sequence
+    using RequestSnapshot = std::function<std::shared_ptr<const typename Snapshots::Request>(std::int64_t min_sequence)>;
+
+    // End is reason stream ends after appended items
+    enum class End {
+        // orderbook is stale or product is not known
+        not_found,
+        // subscriber was lapped by dispatcher
+        slow_consumer,
+    };
+
+    OrderBookFeed(Source& source, std::string product_id, std::size_t batch_size, bool conflate, RequestSnapshot request_snapshot);
+
+    OrderBookFeed(const OrderBookFeed&) = delete;
+    OrderBookFeed& operator=(const OrderBookFeed&) = delete;
+
+    // start subscribes to updates of product and requests snapshot that stream starts from
+    std::optional<End> start(std::vector<Item>& out);
+
+    // next appends items that are available to out
+    std::optional<End> next(std::vector<Item>& out);
+
+    // watch arms watch to be invoked once next can append items, returns false if it already can
+    bool watch(Signal::Watch& watch);
+
+    // receive conflates updates while items are written and arms watch for more
+    void receive(Signal::Watch& watch);
+
+private:
+    Source& _source;
+    const std::string _product_id;
+    const std::size_t _batch_size;
+    const bool _conflate;
+    const RequestSnapshot _request_snapshot;
+
+    std::shared_ptr<Subscriber<OrderBook::Update>> _subscriber;
+
+    // sequence of appended items, it moves to snapshot sequence once snapshot is appended
+    std::int64_t _written = 0;
+
+    // updates to be appended, after snapshot if it is requested
+    std::vector<Message<OrderBook::Update>> _backlog;
+
+    // snapshot being made and sequence it must not be older than
+    std::shared_ptr<const typename Snapshots::Request> _snapshot;
+    std::int64_t _min_sequence = 0;
+
+    // conflator and sequence stream caught up with when it was created
+    std::optional<Conflator> _conflator;
+    std::int64_t _sequence = 0;
+    bool _overflowed = false;
+    std::vector<Message<OrderBook::Update>> _batch;
+
+    // append appends requested snapshot once it is ready and backlog after it, up to resync that requests another one
+    std::optional<End> append(std::vector<Item>& out);
+
+    // conflate pushes available updates to conflator
+    void conflate();
+};
+
+template <typename T>
+OrderBookFeed<T>::OrderBookFeed(Source& source, std::string product_id, std::size_t batch_size, bool conflate, RequestSnapshot request_snapshot):
+    _source(source), _product_id(std::move(product_id)), _batch_size(batch_size), _conflate(conflate), _request_snapshot(std::move(request_snapshot)) {
+    _batch.reserve(batch_size);
+};
+
+template <typename T>
+std::optional<typename OrderBookFeed<T>::End> OrderBookFeed<T>::start(std::vector<Item>& out) {
+    _subscriber = _source.subscribe_orderbook(_product_id, snapshot_replay);
+
+    // updates after live sequence are dispatched after subscription and will be received
+    auto live = _source.get_depth(_product_id, 0);
+    if (!live) {
+        return End::not_found;
+    };
+
+    // replayed updates let stream continue from older cached snapshot
+    if (_subscriber->drain(_backlog, snapshot_replay, std::chrono::seconds(0)) == PopState::overflow) {
+        return End::slow_consumer;
+    };
+
+    _min_sequence = live->sequence;
+    if (!_backlog.empty()) {
+        _min_sequence = std::min(_min_sequence, _backlog.front()->value().sequence - 1);
+    };
+
+    // snapshot is encoded once for all subscribers joining within freshness window
+    _snapshot = _request_snapshot(_min_sequence);
+
+    return next(out);
+};
+
+template <typename T>
+std::optional<typename OrderBookFeed<T>::End> OrderBookFeed<T>::next(std::vector<Item>& out) {
+    if (!_conflator) {
+        // updates received while snapshot is made are appended after it
+        if (_subscriber->drain(_backlog, _batch_size, std::chrono::seconds(0)) == PopState::overflow) {
+            return End::slow_consumer;
+        };
+
+        if (auto end = append(out)) {
+            return end;
+        };
+
+        if (_conflate && !_snapshot) {
+            _sequence = _written;
+            _conflator.emplace(_batch_size);
+        };
+
+        return std::nullopt;
+    };
+
+    conflate();
+
+    // conflator may hand out pending updates in parts, they are taken until some are appended
+    auto size = out.size();
+    while (out.size() == size) {
+        if (auto end = append(out)) {
+            return end;
+        };
+
+        // updates after resync wait for snapshot that follows it
+        if (_snapshot) {
+            break;
+        };
+
+        auto [pending, state] = _conflator->take();
+
+        if (state == PopState::overflow) {
+            return End::slow_consumer;
+        };
+
+        // nothing is pending
+        if (state == PopState::timeout) {
+            break;
+        };
+
+        if (auto updates = std::get_if<Conflator::Updates>(&*pending)) {
+            _backlog = std::move(*updates);
+            continue;
+        };
+
+        // entries of delta carry their actual price and size, so delta overlapping snapshot is still valid
+        auto& delta = std::get<Conflator::Delta>(*pending);
+        if (delta.sequence > _written) {
+            _written = delta.sequence;
+            out.push_back(std::move(delta));
+        };
+    };
+
+    return std::nullopt;
+};
+
+template <typename T>
+bool OrderBookFeed<T>::watch(Signal::Watch& watch) {
+    // stream waiting for snapshot continues once it is made
+    if (_snapshot) {
+        return _snapshot->watch(watch);
+    };
+
+    return _subscriber->watch(watch);
+};
+
+template <typename T>
+void OrderBookFeed<T>::receive(Signal::Watch& watch) {
+    if (!_conflator) {
+        return;
+    };
+
+    do {
+        conflate();
+    } while (!_overflowed && !_subscriber->watch(watch));
+};
+
+template <typename T>
+std::optional<typename OrderBookFeed<T>::End> OrderBookFeed<T>::append(std::vector<Item>& out) {
+    while (true) {
+        if (_snapshot) {
+            if (!_snapshot->ready()) {
+                return std::nullopt;
+            };
+
+            auto snapshot = _snapshot->snapshot();
+            if (!snapshot) {
+                return End::not_found;
+            };
+
+            // snapshot of request shared with earlier subscribers may be older than this stream needs
+            if (snapshot->sequence < _min_sequence) {
+                _snapshot = _request_snapshot(_min_sequence);
+                continue;
+            };
+
+            _snapshot.reset();
+            _written = snapshot->sequence;
+            out.push_back(std::move(snapshot));
+        };
+
+        auto it = _backlog.begin();
+        for (; it != _backlog.end() && !_snapshot; it++) {
+            // ignore updates that are already in orderbook
+            if (!is_new((*it)->value(), _written)) {
+                continue;
+            };
+
+            _written = (*it)->value().sequence;
+
+            // orderbook was replaced, snapshot includes updates published after resync that are then skipped
+            if ((*it)->value().resync) {
+                _min_sequence = _written;
+                _snapshot = _request_snapshot(_min_sequence);
+            };
+
+            out.push_back(std::move(*it));
+        };
+
+        _backlog.erase(_backlog.begin(), it);
+
+        if (!_snapshot) {
+            return std::nullopt;
+        };
+    };
+};
+
+template <typename T>
+void OrderBookFeed<T>::conflate() {
+    while (!_overflowed) {
+        _batch.clear();
+
+        if (_subscriber->drain(_batch, _batch_size, std::chrono::seconds(0)) == PopState::overflow) {
+            _overflowed = true;
+            _conflator->overflow();
+            return;
+        };
+
+        if (_batch.empty()) {
+            return;
+        };
+
+        for (auto& update: _batch) {
+            // ignore updates that are already in orderbook
+            if (is_new(update->value(), _sequence)) {
+                _conflator->push(std::move(update));
+            };
+        };
+    };
+};
+
+#endif
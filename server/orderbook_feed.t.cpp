@@ -0,0 +1,338 @@
+#include "orderbook_feed.h"
+
+#include <boost/asio/io_context.hpp>
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+// FakeSource dispatches updates of single product, its orderbook is empty at the sequence of the last update
+class FakeSource: public Source {
+public:
+    FakeSource(): Source({"BTC-USD"}), dispatcher{1024, &OrderBook::Update::product_id} {};
+
+    std::int64_t sequence = 0;
+    bool stale = false;
+
+    // update dispatches updates up to sequence
+    void update(std::int64_t to) {
+        while (sequence < to) {
+            dispatcher.dispatch(OrderBook::Update{.product_id = "BTC-USD", .sequence = ++sequence});
+        };
+    };
+
+    // lose marks orderbook stale, updates up to sequence are lost
+    void lose(std::int64_t to) {
+        dispatcher.dispatch(OrderBook::Update{.product_id = "BTC-USD", .sequence = sequence, .stale = true});
+        stale = true;
+        sequence = to;
+    };
+
+    // resync replaces stale orderbook
+    void resync() {
+        stale = false;
+        dispatcher.dispatch(OrderBook::Update{.product_id = "BTC-USD", .sequence = sequence, .resync = true});
+    };
+
+    std::shared_ptr<const OrderBook> get_orderbook(const std::string& product_id) override {
+        if (stale) {
+            return nullptr;
+        };
+
+        return std::make_shared<const OrderBook>(sequence, std::vector<OrderBook::Entry>{}, std::vector<OrderBook::Entry>{});
+    };
+
+    std::optional<OrderBook::Depth> get_depth(const std::string& product_id, std::size_t n) override {
+        if (stale) {
+            return std::nullopt;
+        };
+
+        return OrderBook::Depth{.sequence = sequence};
+    };
+
+    std::optional<TopOfBook> get_top_of_book(const std::string& product_id) override { return std::nullopt; };
+
+    std::shared_ptr<Subscriber<OrderBook::Update>> subscribe_orderbook(const std::string& product_id, std::size_t replay) override {
+        return dispatcher.subscribe(product_id, replay);
+    };
+
+    std::shared_ptr<Subscriber<Trade>> subscribe_trade(const std::string& product_id) override { return nullptr; };
+    std::shared_ptr<Subscriber<TopOfBook>> subscribe_top_of_book(const std::string& product_id) override { return nullptr; };
+    std::shared_ptr<Subscriber<Level2>> subscribe_level2(const std::string& product_id) override { return nullptr; };
+
+    void run() override { };
+    bool ready() override { return true; };
+
+private:
+    Dispatcher<OrderBook::Update> dispatcher;
+};
+
+using Feed = OrderBookFeed<std::string>;
+
+// sequences returns sequences of items, snapshots are prefixed with "s" and resyncs with "r"
+std::vector<std::string> sequences(const std::vector<Feed::Item>& items) {
+    std::vector<std::string> dst;
+
+    for (const auto& item: items) {
+        if (auto snapshot = std::get_if<std::shared_ptr<const Feed::Snapshots::Snapshot>>(&item)) {
+            dst.push_back("s" + std::to_string((*snapshot)->sequence));
+        } else if (auto update = std::get_if<Message<OrderBook::Update>>(&item)) {
+            dst.push_back(((*update)->value().resync ? "r" : "") + std::to_string((*update)->value().sequence));
+        } else {
+            dst.push_back("d" + std::to_string(std::get<Conflator::Delta>(item).sequence));
+        };
+    };
+
+    return dst;
+};
+
+// require_continuous checks that stream starts with snapshot and every update follows the previous item
+// Stale update repeats sequence it follows and resync update is followed by snapshot that is not older.
+void require_continuous(const std::vector<Feed::Item>& items) {
+    REQUIRE( !items.empty() );
+
+    auto first = std::get_if<std::shared_ptr<const Feed::Snapshots::Snapshot>>(&items.front());
+    REQUIRE( first );
+
+    auto sequence = (*first)->sequence;
+    auto resynced = false;
+
+    for (auto item = std::next(items.begin()); item != items.end(); item++) {
+        if (auto snapshot = std::get_if<std::shared_ptr<const Feed::Snapshots::Snapshot>>(&*item)) {
+            REQUIRE( resynced );
+            REQUIRE( (*snapshot)->sequence >= sequence );
+
+            sequence = (*snapshot)->sequence;
+            resynced = false;
+            continue;
+        };
+
+        const auto& update = std::get<Message<OrderBook::Update>>(*item)->value();
+        REQUIRE( !resynced );
+
+        if (update.stale) {
+            REQUIRE( update.sequence == sequence );
+        } else if (update.resync) {
+            REQUIRE( update.sequence > sequence );
+            resynced = true;
+        } else {
+            REQUIRE( update.sequence == sequence + 1 );
+        };
+
+        sequence = update.sequence;
+    };
+};
+
+} // anonymous namespace
+
+TEST_CASE( "OrderBookFeed", "[orderbook_feed]" ) {
+    FakeSource source;
+
+    // subscriber keeps ring of product, so that it retains updates dispatched before feed subscribes
+    auto retained = source.subscribe_orderbook("BTC-USD", 0);
+
+    // snapshots are made when test runs encoder
+    boost::asio::io_context encoder;
+    auto encode = [&] {
+        encoder.restart();
+        encoder.run();
+    };
+
+    int made = 0;
+    SnapshotCache<std::string> snapshots{std::chrono::hours(1)};
+    auto request = [&](std::int64_t min_sequence) {
+        return snapshots.request("BTC-USD", min_sequence, encoder.get_executor(), [&]() -> std::optional<Feed::Snapshots::Snapshot> {
+            made++;
+
+            auto orderbook = source.get_orderbook("BTC-USD");
+            if (!orderbook) {
+                return std::nullopt;
+            };
+
+            return Feed::Snapshots::Snapshot{.sequence = orderbook->sequence(), .value = "BTC-USD"};
+        });
+    };
+
+    // cache snapshot at sequence
+    auto cache = [&](std::int64_t sequence) {
+        source.update(sequence);
+        request(sequence);
+        encode();
+    };
+
+    Feed feed{source, "BTC-USD", 1024, false, request};
+    std::vector<Feed::Item> items;
+
+    SECTION( "cached snapshot right before replayed updates is continued with them" ) {
+        cache(1000);
+        source.update(1000 + snapshot_replay);
+
+        REQUIRE( !feed.start(items) );
+
+        REQUIRE( made == 1 );
+        REQUIRE( items.size() == snapshot_replay + 1 );
+        REQUIRE( sequences(items).front() == "s1000" );
+        REQUIRE( sequences(items).back() == std::to_string(1000 + snapshot_replay) );
+        require_continuous(items);
+    }
+
+    SECTION( "cached snapshot older than replayed updates is made again" ) {
+        cache(999);
+        source.update(1000 + snapshot_replay);
+
+        REQUIRE( !feed.start(items) );
+
+        // stream waits for snapshot
+        REQUIRE( items.empty() );
+
+        Signal::Watch watch{[] { }};
+        REQUIRE( feed.watch(watch) );
+
+        encode();
+
+        REQUIRE( !feed.watch(watch) );
+        REQUIRE( !feed.next(items) );
+
+        REQUIRE( made == 2 );
+        REQUIRE( sequences(items) == std::vector<std::string>{"s" + std::to_string(1000 + snapshot_replay)} );
+
+        source.update(1002 + snapshot_replay);
+        REQUIRE( !feed.next(items) );
+
+        REQUIRE( items.size() == 3 );
+        require_continuous(items);
+    }
+
+    SECTION( "snapshot newer than live orderbook skips updates it includes" ) {
+        source.update(10);
+
+        REQUIRE( !feed.start(items) );
+        REQUIRE( items.empty() );
+
+        // orderbook moved on before snapshot was made
+        source.update(20);
+        encode();
+        source.update(25);
+
+        REQUIRE( !feed.next(items) );
+
+        REQUIRE( sequences(items) == std::vector<std::string>{"s20", "21", "22", "23", "24", "25"} );
+        require_continuous(items);
+    }
+
+    SECTION( "updates after cached snapshot within replay are replayed" ) {
+        cache(10);
+        source.update(15);
+
+        REQUIRE( !feed.start(items) );
+
+        source.update(17);
+        REQUIRE( !feed.next(items) );
+
+        REQUIRE( sequences(items) == std::vector<std::string>{"s10", "11", "12", "13", "14", "15", "16", "17"} );
+        require_continuous(items);
+    }
+
+    SECTION( "snapshot of shared request that is older than replayed updates is requested again" ) {
+        source.update(10);
+
+        // request of other subscriber is pending while orderbook moves on
+        request(0);
+        source.update(10 + 2 * snapshot_replay);
+
+        REQUIRE( !feed.start(items) );
+
+        // shared request was made before the orderbook moved on
+        source.sequence = 10;
+        encode();
+        source.sequence = 10 + 2 * snapshot_replay;
+
+        REQUIRE( !feed.next(items) );
+        REQUIRE( items.empty() );
+
+        encode();
+
+        REQUIRE( !feed.next(items) );
+        REQUIRE( sequences(items) == std::vector<std::string>{"s" + std::to_string(10 + 2 * snapshot_replay)} );
+    }
+
+    SECTION( "resync is followed by snapshot" ) {
+        cache(10);
+
+        REQUIRE( !feed.start(items) );
+
+        source.update(12);
+        source.lose(20);
+        source.resync();
+        source.update(22);
+
+        REQUIRE( !feed.next(items) );
+
+        // updates after resync wait for snapshot
+        REQUIRE( sequences(items) == std::vector<std::string>{"s10", "11", "12", "12", "r20"} );
+
+        Signal::Watch watch{[] { }};
+        REQUIRE( feed.watch(watch) );
+
+        encode();
+
+        REQUIRE( !feed.next(items) );
+
+        REQUIRE( sequences(items) == std::vector<std::string>{"s10", "11", "12", "12", "r20", "s22"} );
+        require_continuous(items);
+
+        source.update(23);
+        REQUIRE( !feed.next(items) );
+
+        REQUIRE( sequences(items).back() == "23" );
+        require_continuous(items);
+    }
+
+    SECTION( "stale orderbook ends stream" ) {
+        source.update(10);
+        source.lose(20);
+
+        REQUIRE( feed.start(items) == Feed::End::not_found );
+    }
+
+    SECTION( "orderbook that became stale while snapshot was made ends stream" ) {
+        source.update(10);
+
+        REQUIRE( !feed.start(items) );
+
+        source.lose(20);
+        encode();
+
+        REQUIRE( feed.next(items) == Feed::End::not_found );
+    }
+}
+
+TEST_CASE( "OrderBookFeed conflates updates after snapshot", "[orderbook_feed]" ) {
+    FakeSource source;
+    source.update(10);
+
+    boost::asio::io_context encoder;
+
+    SnapshotCache<std::string> snapshots{std::chrono::hours(1)};
+    auto request = [&](std::int64_t min_sequence) {
+        return snapshots.request("BTC-USD", min_sequence, encoder.get_executor(), [&]() -> std::optional<Feed::Snapshots::Snapshot> {
+            return Feed::Snapshots::Snapshot{.sequence = source.sequence, .value = "BTC-USD"};
+        });
+    };
+
+    Feed feed{source, "BTC-USD", 2, true, request};
+    std::vector<Feed::Item> items;
+
+    REQUIRE( !feed.start(items) );
+
+    encoder.run();
+
+    REQUIRE( !feed.next(items) );
+    REQUIRE( sequences(items) == std::vector<std::string>{"s10"} );
+
+    // updates over limit are merged to delta
+    source.update(15);
+    REQUIRE( !feed.next(items) );
+
+    REQUIRE( sequences(items) == std::vector<std::string>{"s10", "d15"} );
+}
@@ -1,172 +1,366 @@
 #include "quote_service.h"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <future>
+#include <optional>
 #include <variant>
 
-#include <boost/range/adaptors.hpp>
+#include "level_view.h"
+#include "orderbook_feed.h"
+#include "throttle.h"
+#include "wire.h"
 
 namespace {
 
-quote::OrderBookEntry map_orderbook_entry(const OrderBook::Entry& src) {
-    quote::OrderBookEntry dst;
+// shared_frame returns frame of message whose buffer is shared by all streams writing it
+template <typename T>
+StreamWriter::Frame shared_frame(const Message<T>& message) {
+    return {message, &frame(message)};
+};
 
-    dst.set_order_id(src.order_id);
-    dst.set_price(src.price.str());
-    dst.set_quantity(src.size.str());
+// owned_frame returns frame of buffer encoded for single stream
+StreamWriter::Frame owned_frame(grpc::ByteBuffer&& buffer) {
+    auto owner = std::make_shared<const grpc::ByteBuffer>(std::move(buffer));
+    return {owner, owner.get()};
+};
 
-    return dst;
+// slow_consumer ends stream that was lapped by dispatcher
+grpc::Status slow_consumer() {
+    return grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, "slow consumer");
 };
 
-quote::OrderBook map_orderbook(const std::string& product_id, const OrderBook& src) {
-    quote::OrderBook dst;
+// FinishPump finishes stream with status without writing anything
+class FinishPump final: public StreamWriter::Pump {
+public:
+    explicit FinishPump(grpc::Status status): _status(std::move(status)) {};
+
+    std::optional<grpc::Status> next(std::vector<StreamWriter::Frame>& out) override { return _status; };
+    bool watch(Signal::Watch& watch) override { return false; };
 
-    dst.set_product_id(product_id);
-    dst.set_sequence(src.sequence());
+private:
+    grpc::Status _status;
+};
 
-    auto asks = dst.mutable_asks();
-    for (const auto& entry: src.bids() | boost::adaptors::map_values) {
-        asks->Add(map_orderbook_entry(entry));
+// SubscriberPump writes messages of subscriber
+template <typename T>
+class SubscriberPump: public StreamWriter::Pump {
+public:
+    explicit SubscriberPump(std::size_t batch_size): _batch_size(batch_size) {
+        _batch.reserve(batch_size);
     };
 
-    auto bids = dst.mutable_bids();
-    for (const auto& entry: src.asks() | boost::adaptors::map_values) {
-        bids->Add(map_orderbook_entry(entry));
+    bool watch(Signal::Watch& watch) override {
+        return _subscriber->watch(watch);
     };
 
-    return dst;
+protected:
+    const std::size_t _batch_size;
+    std::shared_ptr<Subscriber<T>> _subscriber;
+    std::vector<Message<T>> _batch;
+
+    // drain replaces batch with messages that are available, returns status that ends stream if subscriber was lapped
+    std::optional<grpc::Status> drain() {
+        _batch.clear();
+
+        if (_subscriber->drain(_batch, _batch_size, std::chrono::seconds(0)) == PopState::overflow) {
+            return slow_consumer();
+        };
+
+        return std::nullopt;
+    };
 };
 
-quote::OrderBook map_orderbook_update(const OrderBook::Update& src) {
-    quote::OrderBook dst;
+} // anonymous namespace
 
-    dst.set_product_id(src.product_id);
-    dst.set_sequence(src.sequence);
+class QuoteServiceImpl::OrderBookPump final: public StreamWriter::Pump {
+public:
+    using Feed = OrderBookFeed<grpc::ByteBuffer>;
 
-    quote::OrderBookEntry* entry;
+    OrderBookPump(QuoteServiceImpl& service, quote::SubscribeOrderBookRequest&& request):
+        _service(service), _product_id(request.product_id()),
+        _feed(service._source, request.product_id(), service._batch_size, request.conflate(), [&service, product_id = request.product_id()](std::int64_t min_sequence) {
+            return service.snapshot(product_id, min_sequence);
+        }) {};
 
-    if (src.bid) {
-        dst.mutable_bids()->Add(map_orderbook_entry(*src.bid));
+    std::optional<grpc::Status> start(std::vector<StreamWriter::Frame>& out) override {
+        if (!_service._source.ready()) {
+            return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Unavailable");
+        };
+
+        _items.clear();
+        auto end = _feed.start(_items);
+
+        return write(out, end);
+    };
+
+    std::optional<grpc::Status> next(std::vector<StreamWriter::Frame>& out) override {
+        _items.clear();
+        auto end = _feed.next(_items);
+
+        return write(out, end);
     };
 
-    if (src.ask) {
-        dst.mutable_asks()->Add(map_orderbook_entry(*src.ask));
+    bool watch(Signal::Watch& watch) override {
+        return _feed.watch(watch);
     };
 
-    return dst;
+    // conflating stream keeps up with subscriber while frames are written to slow client
+    void receive(Signal::Watch& watch) override {
+        _feed.receive(watch);
+    };
+
+private:
+    QuoteServiceImpl& _service;
+    const std::string _product_id;
+
+    Feed _feed;
+    std::vector<Feed::Item> _items;
+
+    // write appends frames of items and returns status of stream that feed ended
+    std::optional<grpc::Status> write(std::vector<StreamWriter::Frame>& out, std::optional<Feed::End> end) {
+        for (auto& item: _items) {
+            if (auto snapshot = std::get_if<std::shared_ptr<const Feed::Snapshots::Snapshot>>(&item)) {
+                out.push_back({*snapshot, &(*snapshot)->value});
+            } else if (auto update = std::get_if<Message<OrderBook::Update>>(&item)) {
+                out.push_back(shared_frame(*update));
+            } else {
+                out.push_back(owned_frame(serialize(map_orderbook_delta(std::get<Conflator::Delta>(item)))));
+            };
+        };
+
+        if (!end) {
+            return std::nullopt;
+        };
+
+        switch (*end) {
+        case Feed::End::not_found:
+            return _service.not_found(_product_id);
+        case Feed::End::slow_consumer:
+            return slow_consumer();
+        };
+
+        return std::nullopt;
+    };
 };
 
-quote::Trade map_trade(const Trade& src) {
-    quote::Trade dst;
+class QuoteServiceImpl::Level2Pump final: public SubscriberPump<Level2> {
+public:
+    Level2Pump(QuoteServiceImpl& service, quote::SubscribeLevel2Request&& request): SubscriberPump(service._batch_size), _service(service), _product_id(request.product_id()), _depth(request.depth()) {};
+
+    std::optional<grpc::Status> start(std::vector<StreamWriter::Frame>& out) override {
+        if (!_service._source.ready()) {
+            return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Unavailable");
+        };
+
+        if (_depth == 0 || _depth > level2_depth) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Invalid depth");
+        };
+
+        _subscriber = _service._source.subscribe_level2(_product_id);
+
+        // changes after sequence of levels are dispatched after subscription and will be received
+        auto levels = _service._source.get_depth(_product_id, level2_depth);
+        if (!levels) {
+            return _service.not_found(_product_id);
+        };
+
+        _view.emplace(_depth, *levels);
 
-    dst.set_product_id(src.product_id);
-    dst.set_time(src.time);
+        // send all levels within depth
+        auto written = _view->levels();
+        out.push_back(owned_frame(serialize(map_level2(_product_id, written.sequence, written.bids, written.asks))));
 
-    switch (src.side) {
-    case Side::bid:
-        dst.set_side(quote::Side::BID); break;
-    case Side::ask:
-        dst.set_side(quote::Side::ASK); break;
+        return std::nullopt;
     };
 
-    dst.set_maker_order_id(src.maker_order_id);
-    dst.set_taker_order_id(src.taker_order_id);
-    dst.set_price(src.price.str());
-    dst.set_size(src.size.str());
+    std::optional<grpc::Status> next(std::vector<StreamWriter::Frame>& out) override {
+        if (auto status = drain()) {
+            return status;
+        };
 
-    return dst;
-};
+        // orderbook was replaced, its levels are read again
+        auto fetch = [this] { return _service._source.get_depth(_product_id, level2_depth); };
 
-} // anonymous namespace
+        _changes.clear();
+        for (const auto& message: _batch) {
+            _view->apply(message->value(), fetch, _changes);
+        };
+        _view->flush(_changes);
+
+        for (const auto& changes: _changes) {
+            auto level2 = map_level2(_product_id, changes.sequence, changes.bids, changes.asks);
+            level2.set_stale(changes.stale);
+            out.push_back(owned_frame(serialize(level2)));
+        };
+
+        return std::nullopt;
+    };
 
-QuoteServiceImpl::QuoteServiceImpl(Source& source): _source(source) {
+private:
+    QuoteServiceImpl& _service;
+    const std::string _product_id;
+    const std::size_t _depth;
 
+    std::optional<Level2View> _view;
+    std::vector<Level2View::Changes> _changes;
 };
 
-grpc::Status QuoteServiceImpl::SubscribeOrderBook(grpc::ServerContext* context, const quote::SubscribeOrderBookRequest* request, grpc::ServerWriter<quote::OrderBook>* writer) {
-    if (!_source.ready()) {
-        return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Unavailable");
+class QuoteServiceImpl::TopOfBookPump final: public SubscriberPump<TopOfBook> {
+public:
+    TopOfBookPump(QuoteServiceImpl& service, quote::SubscribeTopOfBookRequest&& request): SubscriberPump(service._batch_size), _service(service), _product_id(request.product_id()), _throttle(std::chrono::milliseconds(request.throttle_ms())) {};
+
+    std::optional<grpc::Status> start(std::vector<StreamWriter::Frame>& out) override {
+        if (!_service._source.ready()) {
+            return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Unavailable");
+        };
+
+        _subscriber = _service._source.subscribe_top_of_book(_product_id);
+
+        auto current = _service._source.get_top_of_book(_product_id);
+        if (!current) {
+            return _service.not_found(_product_id);
+        };
+
+        out.push_back(owned_frame(serialize(map_top_of_book(*current))));
+
+        _sequence = current->sequence;
+        _throttle.start(std::chrono::steady_clock::now());
+
+        return std::nullopt;
     };
 
-    auto product_id = request->product_id();
-    auto subscriber = _source.subscribe_orderbook(product_id);
+    std::optional<grpc::Status> next(std::vector<StreamWriter::Frame>& out) override {
+        if (auto status = drain()) {
+            return status;
+        };
 
+        // ignore changes that are already in the first message
+        auto begin = std::find_if(_batch.begin(), _batch.end(), [this](const auto& top) {
+            return is_new(top->value(), _sequence);
+        });
 
-    quote::OrderBook orderbook;
-    auto found = _source.get_orderbook(product_id, [&](auto src) {
-        orderbook = std::move(map_orderbook(product_id, src));
-    });
+        if (_throttle.interval().count() == 0) {
+            for (auto it = begin; it != _batch.end(); it++) {
+                out.push_back(shared_frame(*it));
+            };
+
+            if (begin != _batch.end()) {
+                _sequence = _batch.back()->value().sequence;
+            };
 
-    if (!found) {
-        return grpc::Status(grpc::StatusCode::NOT_FOUND, "OrderBook not found");
+            return std::nullopt;
+        };
+
+        if (begin != _batch.end()) {
+            _throttle.offer(_batch.back());
+        };
+
+        if (auto top = _throttle.take(std::chrono::steady_clock::now())) {
+            out.push_back(shared_frame(*top));
+            _sequence = (*top)->value().sequence;
+        };
+
+        return std::nullopt;
     };
 
-    // send the snapshot
-    if (!writer->Write(orderbook)) {
-        return grpc::Status::CANCELLED;
-    }
+    // change held back by throttle is written once interval passes
+    std::optional<std::chrono::steady_clock::time_point> deadline() override {
+        return _throttle.deadline();
+    };
 
-    auto sequence = orderbook.sequence();
+private:
+    QuoteServiceImpl& _service;
+    const std::string _product_id;
 
-    while (!context->IsCancelled()) {
-        auto [res, state] = subscriber->pop(std::chrono::seconds(1));
+    std::int64_t _sequence = 0;
+    Throttle<Message<TopOfBook>> _throttle;
+};
 
-        // slow consumer
-        if (state == PopState::overflow) {
-            return grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, "slow consumer");
+class QuoteServiceImpl::TradePump final: public SubscriberPump<Trade> {
+public:
+    TradePump(QuoteServiceImpl& service, quote::SubscribeTradeRequest&& request): SubscriberPump(service._batch_size), _service(service), _product_id(request.product_id()) {};
+
+    std::optional<grpc::Status> start(std::vector<StreamWriter::Frame>& out) override {
+        if (!_service._source.ready()) {
+            return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Unavailable");
         };
 
-        // no update received
-        if (state == PopState::timeout) {
-            continue;
+        if (!_service._source.find_product(_product_id)) {
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "Product not found");
         };
-        
-        auto update = *res;
 
-        // ignore updates that are already in orderbook
-        if (update.sequence <= sequence) {
-            continue;
-        }
+        _subscriber = _service._source.subscribe_trade(_product_id);
 
-        if (!writer->Write(map_orderbook_update(update))) {
-            break;   
+        return std::nullopt;
+    };
+
+    std::optional<grpc::Status> next(std::vector<StreamWriter::Frame>& out) override {
+        if (auto status = drain()) {
+            return status;
         };
 
-        sequence = update.sequence;
-    }
-    
-    return grpc::Status::CANCELLED;
-};
+        for (const auto& trade: _batch) {
+            out.push_back(shared_frame(trade));
+        };
 
-grpc::Status QuoteServiceImpl::SubscribeTrade(grpc::ServerContext* context, const quote::SubscribeTradeRequest* request, grpc::ServerWriter<quote::Trade>* writer) {
-    if (!_source.ready()) {
-        return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Unavailable");
+        return std::nullopt;
     };
 
+private:
+    QuoteServiceImpl& _service;
+    const std::string _product_id;
+};
+
+QuoteServiceImpl::QuoteServiceImpl(Source& source, std::size_t batch_size, std::chrono::milliseconds snapshot_freshness, std::size_t workers): _source(source), _batch_size(batch_size), _snapshots(snapshot_freshness), _encoder(1), _executor(workers) {
 
-    auto product_id = request->product_id();
-    if (!_source.find_product(product_id)) {
-        return grpc::Status(grpc::StatusCode::NOT_FOUND, "Product not found");
+};
+
+template <typename Request, typename Pump>
+StreamWriter* QuoteServiceImpl::start(const grpc::ByteBuffer* request) {
+    Request parsed;
+    if (!parse(*request, parsed)) {
+        return StreamWriter::start(_executor.get_executor(), std::make_unique<FinishPump>(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Invalid request")));
     };
 
-    auto subscriber = _source.subscribe_trade(product_id);
+    return StreamWriter::start(_executor.get_executor(), std::make_unique<Pump>(*this, std::move(parsed)));
+};
 
-    while (!context->IsCancelled()) {
-        auto [res, state] = subscriber->pop(std::chrono::seconds(1));
+grpc::ServerWriteReactor<grpc::ByteBuffer>* QuoteServiceImpl::SubscribeOrderBook(grpc::CallbackServerContext* context, const grpc::ByteBuffer* request) {
+    return start<quote::SubscribeOrderBookRequest, OrderBookPump>(request);
+};
 
-        // slow consumer
-        if (state == PopState::overflow) {
-            return grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, "slow consumer");
-        };
+grpc::ServerWriteReactor<grpc::ByteBuffer>* QuoteServiceImpl::SubscribeLevel2(grpc::CallbackServerContext* context, const grpc::ByteBuffer* request) {
+    return start<quote::SubscribeLevel2Request, Level2Pump>(request);
+};
+
+grpc::ServerWriteReactor<grpc::ByteBuffer>* QuoteServiceImpl::SubscribeTopOfBook(grpc::CallbackServerContext* context, const grpc::ByteBuffer* request) {
+    return start<quote::SubscribeTopOfBookRequest, TopOfBookPump>(request);
+};
+
+grpc::ServerWriteReactor<grpc::ByteBuffer>* QuoteServiceImpl::SubscribeTrade(grpc::CallbackServerContext* context, const grpc::ByteBuffer* request) {
+    return start<quote::SubscribeTradeRequest, TradePump>(request);
+};
 
-        // no update received
-        if (state == PopState::timeout) {
-            continue;
+std::shared_ptr<const SnapshotCache<grpc::ByteBuffer>::Request> QuoteServiceImpl::snapshot(const std::string& product_id, std::int64_t min_sequence) {
+    return _snapshots.request(product_id, min_sequence, _encoder.get_executor(), [this, product_id]() -> std::optional<SnapshotCache<grpc::ByteBuffer>::Snapshot> {
+        auto orderbook = _source.get_orderbook(product_id);
+        if (!orderbook) {
+            return std::nullopt;
         };
 
-        if (!writer->Write(map_trade(*res))) {
-            break;   
+        return SnapshotCache<grpc::ByteBuffer>::Snapshot{
+            .sequence = orderbook->sequence(),
+            .value = serialize(map_orderbook(product_id, *orderbook)),
         };
+    });
+};
+
+grpc::Status QuoteServiceImpl::not_found(const std::string& product_id) {
+    if (_source.find_product(product_id)) {
+        return grpc::Status(grpc::StatusCode::UNAVAILABLE, "OrderBook is stale");
     };
-    
-    return grpc::Status::CANCELLED;
-};
\ No newline at end of file
+
+    return grpc::Status(grpc::StatusCode::NOT_FOUND, "OrderBook not found");
+};
@@ -1,27 +1,76 @@
 #ifndef QUOTE_SERVICE_H
 #define QUOTE_SERVICE_H 1
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <thread>
 #include <unordered_map>
 
+#include <boost/asio/thread_pool.hpp>
+
 #include <grpcpp/grpcpp.h>
 
 #include "quote.grpc.pb.h"
+#include "quote.pb.h"
 
+#include "snapshot_cache.h"
 #include "source.h"
+#include "stream_writer.h"
 
 using OrderBookDispatcher = Dispatcher<OrderBook::Update>;
 
-class QuoteServiceImpl final : public quote::Quote::Service {
+// QuoteRawService is quote.Quote service whose methods take and return raw bytes
+using QuoteRawService = quote::Quote::WithRawCallbackMethod_SubscribeOrderBook<
+    quote::Quote::WithRawCallbackMethod_SubscribeLevel2<
+    quote::Quote::WithRawCallbackMethod_SubscribeTopOfBook<
+    quote::Quote::WithRawCallbackMethod_SubscribeTrade<quote::Quote::Service>>>>;
+
+// QuoteServiceImpl implements quote.Quote service (see api/quote.proto).
+// Responses are written as raw bytes so that frames encoded once can be shared by all streams.
+// Each stream is StreamWriter reactor whose pump runs on shared executor, stream waiting for messages holds no thread.
+class QuoteServiceImpl final : public QuoteRawService {
 public:
-    QuoteServiceImpl(Source& source);
+    // batch_size limits number of messages written to stream before it is flushed
+    // snapshot_freshness is how long encoded orderbook snapshot is reused for new subscribers
+    // workers is number of threads that run pumps of all streams
+    QuoteServiceImpl(Source& source, std::size_t batch_size = 256, std::chrono::milliseconds snapshot_freshness = std::chrono::seconds(1), std::size_t workers = std::max(std::thread::hardware_concurrency(), 1u));
 
-    grpc::Status SubscribeOrderBook(grpc::ServerContext* context, const quote::SubscribeOrderBookRequest* request, grpc::ServerWriter<quote::OrderBook>* writer);
-    grpc::Status SubscribeTrade(grpc::ServerContext* context, const quote::SubscribeTradeRequest* request, grpc::ServerWriter<quote::Trade>* writer);
+    grpc::ServerWriteReactor<grpc::ByteBuffer>* SubscribeOrderBook(grpc::CallbackServerContext* context, const grpc::ByteBuffer* request) override;
+    grpc::ServerWriteReactor<grpc::ByteBuffer>* SubscribeLevel2(grpc::CallbackServerContext* context, const grpc::ByteBuffer* request) override;
+    grpc::ServerWriteReactor<grpc::ByteBuffer>* SubscribeTopOfBook(grpc::CallbackServerContext* context, const grpc::ByteBuffer* request) override;
+    grpc::ServerWriteReactor<grpc::ByteBuffer>* SubscribeTrade(grpc::CallbackServerContext* context, const grpc::ByteBuffer* request) override;
 
 private:
+    // pumps of streams of each method
+    class OrderBookPump;
+    class Level2Pump;
+    class TopOfBookPump;
+    class TradePump;
+
     Source& _source;
+    const std::size_t _batch_size;
+
+    SnapshotCache<grpc::ByteBuffer> _snapshots;
+
+    // thread that copies and encodes orderbook snapshots, so that pumps waiting for them do not block executor
+    boost::asio::thread_pool _encoder;
+
+    // declared last so that pumps are stopped before anything they use is destroyed
+    boost::asio::thread_pool _executor;
+
+    // start parses request and starts stream served by pump created from it
+    template <typename Request, typename Pump>
+    StreamWriter* start(const grpc::ByteBuffer* request);
+
+    // snapshot requests encoded orderbook that is not older than min_sequence, shared by subscribers within freshness window
+    // Snapshot is made on encoder, request is ready once it is made.
+    std::shared_ptr<const SnapshotCache<grpc::ByteBuffer>::Request> snapshot(const std::string& product_id, std::int64_t min_sequence);
+
+    // not_found returns UNAVAILABLE if product is known but its orderbook is stale and NOT_FOUND otherwise
+    grpc::Status not_found(const std::string& product_id);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,11 +1,15 @@
 #ifndef RING_BUFFER_H
 #define RING_BUFFER_H 1
 
-#include <condition_variable>
-#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
 #include <optional>
 #include <vector>
 
+#include "wait.h"
+
 enum class PopState {
     valid,
     overflow,
@@ -18,14 +22,20 @@ struct PopResult {
     PopState state;
 };
 
+// RingBuffer is lock-free single-producer single-consumer queue.
+// Size is rounded up to power of two.
 template<typename T>
 class RingBuffer {
 public:
-    RingBuffer(std::size_t size): data(size), write_pos(0), read_pos(0) {};
+    explicit RingBuffer(std::size_t size, WaitStrategy wait = {}): data(std::bit_ceil(size)), mask(data.size() - 1), wait(wait) {};
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
 
     // Push value to the buffer
     // Return false if there is overflow
-    bool push(const T& value);
+    bool push(const T& value) { return emplace(value); };
+    bool push(T&& value) { return emplace(std::move(value)); };
 
     PopResult<T> pop();
 
@@ -33,69 +43,153 @@ public:
     // Returns State::valid and value if value was retrieved within given timeout.
     // If buffer has overflow then State::overflow is returned immediately.
     // If no value was present before timeout expired then State::timeout is returned.
-    template<typename Rep> PopResult<T> pop_wait(std::chrono::duration<Rep> timeout);
+    template<typename Rep, typename Period> PopResult<T> pop_wait(std::chrono::duration<Rep, Period> timeout);
+
+    // Drain moves up to max_n available values to out, waiting for at least one value.
+    // Returns State::valid if any values were retrieved within given timeout.
+    // If buffer has overflow then State::overflow is returned immediately.
+    // If no value was present before timeout expired then State::timeout is returned.
+    PopState drain(std::vector<T>& out, std::size_t max_n);
+    template<typename Rep, typename Period> PopState drain(std::vector<T>& out, std::size_t max_n, std::chrono::duration<Rep, Period> timeout);
+
 private:
-    std::mutex mtx;
-    std::condition_variable cv;
     std::vector<T> data;
-    std::size_t write_pos, read_pos;
+    const std::size_t mask;
+    const WaitStrategy wait;
+
+    // written by producer
+    alignas(cache_line_size) std::atomic<std::size_t> write_pos{0};
+    std::size_t read_pos_cache{0};
+    std::atomic<bool> overflowed{false};
+
+    // written by consumer
+    alignas(cache_line_size) std::atomic<std::size_t> read_pos{0};
+    std::size_t write_pos_cache{0};
+
+    alignas(cache_line_size) Signal signal;
+
+    template<typename U> bool emplace(U&& value);
+    bool readable();
+    PopResult<T> take();
+    PopState take(std::vector<T>& out, std::size_t max_n);
 };
 
 template<typename T>
-bool RingBuffer<T>::push(const T& value) {
-    {
-        std::unique_lock<std::mutex> lock(mtx);
+template<typename U>
+bool RingBuffer<T>::emplace(U&& value) {
+    // exit immediately if ring buffer has been overflowed
+    if (overflowed.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    auto pos = write_pos.load(std::memory_order_relaxed);
+
+    // refresh consumer position only when buffer appears to be full
+    if (pos - read_pos_cache > mask) {
+        read_pos_cache = read_pos.load(std::memory_order_acquire);
+
+        if (pos - read_pos_cache > mask) {
+            overflowed.store(true, std::memory_order_release);
+            signal.notify();
 
-        // exit immediately if ring buffer has been overflowed
-        if (write_pos - read_pos > data.size()) {
             return false;
         }
-
-        data.at(write_pos % data.size()) = value;
-        write_pos++;
     }
 
-    cv.notify_one();
+    data[pos & mask] = std::forward<U>(value);
+    write_pos.store(pos + 1, std::memory_order_release);
+
+    signal.notify();
 
     return true;
 }
 
 template<typename T>
 PopResult<T> RingBuffer<T>::pop() {
-    std::unique_lock<std::mutex> lock(mtx);
+    signal.wait_until(wait, [this] { return readable(); }, std::nullopt);
 
-    // exit immediately if ring buffer has been overflowed
-    if (write_pos - read_pos > data.size()) {
-        return {std::nullopt, PopState::overflow};
-    };
+    return take();
+}
 
-    cv.wait(lock, [this]{ return read_pos != write_pos; });
+template<typename T>
+template<typename Rep, typename Period>
+PopResult<T> RingBuffer<T>::pop_wait(std::chrono::duration<Rep, Period> timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
 
-    auto res = data.at(read_pos % data.size());
-    read_pos++;
+    if (!signal.wait_until(wait, [this] { return readable(); }, deadline)) {
+        return {std::nullopt, PopState::timeout};
+    }
 
-    return {res, PopState::valid};
+    return take();
 }
 
-template<typename T> 
-template<typename Rep> 
-PopResult<T> RingBuffer<T>::pop_wait(std::chrono::duration<Rep> timeout) {
-    std::unique_lock<std::mutex> lock(mtx);
+template<typename T>
+PopState RingBuffer<T>::drain(std::vector<T>& out, std::size_t max_n) {
+    signal.wait_until(wait, [this] { return readable(); }, std::nullopt);
+
+    return take(out, max_n);
+}
 
+template<typename T>
+template<typename Rep, typename Period>
+PopState RingBuffer<T>::drain(std::vector<T>& out, std::size_t max_n, std::chrono::duration<Rep, Period> timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    if (!signal.wait_until(wait, [this] { return readable(); }, deadline)) {
+        return PopState::timeout;
+    }
+
+    return take(out, max_n);
+}
+
+template<typename T>
+bool RingBuffer<T>::readable() {
+    if (overflowed.load(std::memory_order_acquire)) {
+        return true;
+    }
+
+    auto pos = read_pos.load(std::memory_order_relaxed);
+    if (pos != write_pos_cache) {
+        return true;
+    }
+
+    write_pos_cache = write_pos.load(std::memory_order_acquire);
+
+    return pos != write_pos_cache;
+}
+
+template<typename T>
+PopResult<T> RingBuffer<T>::take() {
     // exit immediately if ring buffer has been overflowed
-    if (write_pos - read_pos > data.size()) {
+    if (overflowed.load(std::memory_order_acquire)) {
         return {std::nullopt, PopState::overflow};
-    };
+    }
 
-    // wait till we have data to read
-    if (!cv.wait_for(lock, timeout, [this]{ return read_pos != write_pos; })) {
-        return {std::nullopt, PopState::timeout};
+    auto pos = read_pos.load(std::memory_order_relaxed);
+    auto res = std::move(data[pos & mask]);
+    read_pos.store(pos + 1, std::memory_order_release);
+
+    return {std::move(res), PopState::valid};
+}
+
+template<typename T>
+PopState RingBuffer<T>::take(std::vector<T>& out, std::size_t max_n) {
+    // exit immediately if ring buffer has been overflowed
+    if (overflowed.load(std::memory_order_acquire)) {
+        return PopState::overflow;
     }
 
-    auto res = data.at(read_pos % data.size());
-    read_pos++;
+    auto pos = read_pos.load(std::memory_order_relaxed);
+    write_pos_cache = write_pos.load(std::memory_order_acquire);
 
-    return {res, PopState::valid};
-};
+    auto n = std::min(write_pos_cache - pos, max_n);
+    for (std::size_t i = 0; i < n; i++) {
+        out.push_back(std::move(data[(pos + i) & mask]));
+    }
+
+    read_pos.store(pos + n, std::memory_order_release);
+
+    return PopState::valid;
+}
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,94 @@
+#include "ring_buffer.h"
+
+#include <future>
+#include <memory>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE( "RingBuffer push and pop", "[ring_buffer]" ) {
+    RingBuffer<int> buffer{4};
+
+    SECTION( "values are popped in order" ) {
+        REQUIRE( buffer.push(1) );
+        REQUIRE( buffer.push(2) );
+
+        auto r1 = buffer.pop_wait(std::chrono::milliseconds(10));
+        auto r2 = buffer.pop_wait(std::chrono::milliseconds(10));
+
+        REQUIRE( r1.state == PopState::valid );
+        REQUIRE( *r1.value == 1 );
+        REQUIRE( r2.state == PopState::valid );
+        REQUIRE( *r2.value == 2 );
+    }
+
+    SECTION( "timeout when empty" ) {
+        auto res = buffer.pop_wait(std::chrono::milliseconds(10));
+
+        REQUIRE( res.state == PopState::timeout );
+        REQUIRE( !res.value );
+    }
+
+    SECTION( "drain takes all available values" ) {
+        REQUIRE( buffer.push(1) );
+        REQUIRE( buffer.push(2) );
+        REQUIRE( buffer.push(3) );
+
+        std::vector<int> out;
+
+        REQUIRE( buffer.drain(out, 2, std::chrono::milliseconds(10)) == PopState::valid );
+        REQUIRE( out == std::vector<int>{1, 2} );
+
+        REQUIRE( buffer.drain(out, 2, std::chrono::milliseconds(10)) == PopState::valid );
+        REQUIRE( out == std::vector<int>{1, 2, 3} );
+
+        REQUIRE( buffer.drain(out, 2, std::chrono::milliseconds(10)) == PopState::timeout );
+    }
+
+    SECTION( "overflow is sticky" ) {
+        for (int i = 0; i < 4; i++) {
+            REQUIRE( buffer.push(i) );
+        }
+
+        REQUIRE( !buffer.push(4) );
+        REQUIRE( buffer.pop_wait(std::chrono::milliseconds(10)).state == PopState::overflow );
+        REQUIRE( !buffer.push(5) );
+    }
+}
+
+TEST_CASE( "RingBuffer moves values", "[ring_buffer]" ) {
+    RingBuffer<std::unique_ptr<int>> buffer{2};
+
+    REQUIRE( buffer.push(std::make_unique<int>(42)) );
+
+    auto [res, state] = buffer.pop();
+
+    REQUIRE( state == PopState::valid );
+    REQUIRE( **res == 42 );
+}
+
+TEST_CASE( "RingBuffer transfers values between threads", "[ring_buffer]" ) {
+    constexpr int count = 100000;
+
+    auto strategy = GENERATE(WaitStrategy{}, WaitStrategy::blocking(), WaitStrategy::busy_spin());
+    // buffer fits all values so that slow consumer does not cause overflow
+    RingBuffer<int> buffer{count, strategy};
+
+    auto consumer = std::async(std::launch::async, [&] {
+        for (int i = 0; i < count; i++) {
+            auto [res, state] = buffer.pop_wait(std::chrono::seconds(10));
+            if (state != PopState::valid || *res != i) {
+                return false;
+            }
+        }
+
+        return true;
+    });
+
+    bool pushed = true;
+    for (int i = 0; i < count && pushed; i++) {
+        pushed = buffer.push(i);
+    }
+
+    REQUIRE( pushed );
+    REQUIRE( consumer.get() );
+}
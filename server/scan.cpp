@@ -0,0 +1,126 @@
+#include "scan.h"
+
+#include <bit>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using FindFn = const char* (*)(const char*, const char*);
+
+const char* find_string_end_scalar(const char* begin, const char* end) {
+    for (; begin < end; begin++) {
+        if (*begin == '"' || *begin == '\\') {
+            break;
+        };
+    };
+
+    return begin;
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse4.2")))
+const char* find_string_end_sse42(const char* begin, const char* end) {
+    const auto set = _mm_setr_epi8('"', '\\', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    for (; end - begin >= 16; begin += 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+
+        // index of the first byte equal to any of two bytes of set, 16 if there is none
+        auto idx = _mm_cmpestri(set, 2, chunk, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if (idx < 16) {
+            return begin + idx;
+        };
+    };
+
+    return find_string_end_scalar(begin, end);
+};
+
+__attribute__((target("avx2")))
+const char* find_string_end_avx2(const char* begin, const char* end) {
+    const auto quote = _mm256_set1_epi8('"');
+    const auto backslash = _mm256_set1_epi8('\\');
+
+    for (; end - begin >= 32; begin += 32) {
+        auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        auto found = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash));
+
+        auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(found));
+        if (mask != 0) {
+            return begin + std::countr_zero(mask);
+        };
+    };
+
+    return find_string_end_sse42(begin, end);
+};
+
+#endif
+
+Isa detect_isa() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        return Isa::AVX2;
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        return Isa::SSE42;
+    };
+#endif
+
+    return Isa::Scalar;
+};
+
+FindFn find_string_end_fn(Isa isa) {
+    switch (isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    case Isa::AVX2:
+        return find_string_end_avx2;
+    case Isa::SSE42:
+        return find_string_end_sse42;
+#endif
+    default:
+        return find_string_end_scalar;
+    };
+};
+
+const Isa detected_isa = detect_isa();
+const FindFn best_find_string_end = find_string_end_fn(detected_isa);
+
+} // anonymous namespace
+
+bool supported(Isa isa) {
+    return isa <= detected_isa;
+};
+
+Isa best_isa() {
+    return detected_isa;
+};
+
+std::string_view isa_name(Isa isa) {
+    switch (isa) {
+    case Isa::Scalar:
+        return "scalar";
+    case Isa::SSE42:
+        return "sse4.2";
+    case Isa::AVX2:
+        return "avx2";
+    };
+
+    return "unknown";
+};
+
+const char* find_string_end(const char* begin, const char* end) {
+    return best_find_string_end(begin, end);
+};
+
+const char* find_string_end(const char* begin, const char* end, Isa isa) {
+    if (!supported(isa)) {
+        throw std::invalid_argument("isa is not supported by cpu");
+    };
+
+    return find_string_end_fn(isa)(begin, end);
+};
@@ -0,0 +1,26 @@
+#ifndef SCAN_H
+#define SCAN_H 1
+
+#include <string_view>
+
+// Isa is instruction set used to scan feed messages
+enum class Isa {
+    Scalar,
+    SSE42,
+    AVX2,
+};
+
+// supported returns whether cpu supports isa, Scalar is always supported
+bool supported(Isa isa);
+
+// best_isa returns the widest isa supported by cpu, it is detected once at startup
+Isa best_isa();
+
+std::string_view isa_name(Isa isa);
+
+// find_string_end returns first quote or backslash in [begin, end) or end if there is none.
+// Input is scanned in vector-sized chunks and never read past end.
+const char* find_string_end(const char* begin, const char* end);
+const char* find_string_end(const char* begin, const char* end, Isa isa);
+
+#endif
@@ -0,0 +1,70 @@
+#include "scan.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+std::vector<Isa> supported_isas() {
+    std::vector<Isa> isas;
+    for (auto isa: {Isa::Scalar, Isa::SSE42, Isa::AVX2}) {
+        if (supported(isa)) {
+            isas.push_back(isa);
+        };
+    };
+
+    return isas;
+};
+
+} // anonymous namespace
+
+TEST_CASE( "find_string_end finds quote or backslash", "[scan]" ) {
+    REQUIRE( supported(Isa::Scalar) );
+    REQUIRE( supported(best_isa()) );
+
+    for (auto isa: supported_isas()) {
+        INFO( "isa " << isa_name(isa) );
+
+        for (std::size_t size = 0; size <= 80; size++) {
+            std::string data(size, 'a');
+
+            REQUIRE( find_string_end(data.data(), data.data() + size, isa) == data.data() + size );
+
+            for (std::size_t pos = 0; pos < size; pos++) {
+                for (auto c: {'"', '\\'}) {
+                    data[pos] = c;
+                    REQUIRE( find_string_end(data.data(), data.data() + size, isa) == data.data() + pos );
+
+                    // match past end is not reported
+                    REQUIRE( find_string_end(data.data(), data.data() + pos, isa) == data.data() + pos );
+                    data[pos] = 'a';
+                };
+            };
+        };
+    };
+
+    if (!supported(Isa::AVX2)) {
+        REQUIRE_THROWS_AS( find_string_end(nullptr, nullptr, Isa::AVX2), std::invalid_argument );
+    };
+}
+
+TEST_CASE( "find_string_end per isa", "[!benchmark][scan]" ) {
+    // values of full channel messages are short, order ids and times are the longest ones
+    std::vector<std::string> values;
+    for (int i = 0; i < 1000; i++) {
+        values.push_back(i % 2 ? "2021-04-19T12:31:04.291522Z\"" : "7a5e9c2b-3f2d-4d6b-9f63-2b0a4f7d8e91\"");
+    };
+
+    for (auto isa: supported_isas()) {
+        BENCHMARK( std::string{isa_name(isa)} ) {
+            std::size_t n = 0;
+            for (const auto& value: values) {
+                n += find_string_end(value.data(), value.data() + value.size(), isa) - value.data();
+            };
+            return n;
+        };
+    };
+}
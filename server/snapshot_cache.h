@@ -0,0 +1,133 @@
+#ifndef SNAPSHOT_CACHE_H
+#define SNAPSHOT_CACHE_H 1
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <boost/asio/post.hpp>
+
+#include "wait.h"
+
+// SnapshotCache holds the latest encoded snapshot of each key together with its sequence.
+// Snapshot is reused by all callers within freshness window, so that burst of new subscribers
+// encodes the snapshot once. Callers continue from sequence of the snapshot they received.
+// Snapshots are made on executor given by caller, so that callers that must not block (ie. stream pumps)
+// do not copy and encode the snapshot themselves, they watch request and take the snapshot once it is ready.
+template<typename T>
+class SnapshotCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Snapshot {
+        std::int64_t sequence;
+        T value;
+    };
+
+    // Request is snapshot that is being made, it is shared by all callers that requested it meanwhile
+    class Request {
+    public:
+        explicit Request(Signal& signal): _signal(signal) {};
+
+        inline bool ready() const { return _ready.load(std::memory_order_acquire); };
+
+        // snapshot returns snapshot of ready request, nullptr if make returned nothing
+        // Exception thrown by make is rethrown.
+        std::shared_ptr<const Snapshot> snapshot() const {
+            if (_error) {
+                std::rethrow_exception(_error);
+            };
+
+            return _snapshot;
+        };
+
+        // watch arms watch to be invoked once request is ready, returns false if it already is
+        bool watch(Signal::Watch& watch) const {
+            return _signal.watch(watch, [this] { return ready(); });
+        };
+
+    private:
+        friend class SnapshotCache;
+
+        // signal of cache entry, it outlives requests and watches armed on it
+        Signal& _signal;
+
+        // fields are written by make before ready is set
+        std::atomic<bool> _ready{false};
+        std::shared_ptr<const Snapshot> _snapshot;
+        std::exception_ptr _error;
+    };
+
+    explicit SnapshotCache(Clock::duration freshness): _freshness(freshness) {};
+
+    SnapshotCache(const SnapshotCache&) = delete;
+    SnapshotCache& operator=(const SnapshotCache&) = delete;
+
+    // request returns snapshot of key that is fresh and not older than min_sequence, otherwise it posts make to executor
+    // make returns std::optional<Snapshot>, request yields nullptr if it returns nothing.
+    // Concurrent callers of the same key share single make instead of making their own, so snapshot of request
+    // that was pending may be older than min_sequence. Caller then requests it again.
+    template<typename Executor, typename F>
+    std::shared_ptr<const Request> request(const std::string& key, std::int64_t min_sequence, const Executor& executor, F&& make);
+
+private:
+    struct Entry {
+        Signal signal;
+        std::shared_ptr<Request> request;
+        Clock::time_point created;
+    };
+
+    const Clock::duration _freshness;
+
+    // guards entries and their requests, make runs without it
+    std::mutex _mtx;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> _entries;
+};
+
+template<typename T>
+template<typename Executor, typename F>
+std::shared_ptr<const typename SnapshotCache<T>::Request> SnapshotCache<T>::request(const std::string& key, std::int64_t min_sequence, const Executor& executor, F&& make) {
+    auto lock = std::unique_lock(_mtx);
+
+    auto& e = _entries[key];
+    if (!e) {
+        e = std::make_unique<Entry>();
+    };
+
+    auto now = Clock::now();
+    if (e->request && !e->request->ready()) {
+        return e->request;
+    };
+
+    // missing snapshot is not cached
+    if (e->request && e->request->_snapshot && now - e->created < _freshness && e->request->_snapshot->sequence >= min_sequence) {
+        return e->request;
+    };
+
+    auto request = std::make_shared<Request>(e->signal);
+    e->request = request;
+    e->created = now;
+
+    boost::asio::post(executor, [request, make = std::forward<F>(make)]() mutable {
+        try {
+            if (std::optional<Snapshot> snapshot = make()) {
+                request->_snapshot = std::make_shared<const Snapshot>(std::move(*snapshot));
+            };
+        } catch (...) {
+            request->_error = std::current_exception();
+        };
+
+        request->_ready.store(true, std::memory_order_release);
+        request->_signal.notify();
+    });
+
+    return request;
+};
+
+#endif
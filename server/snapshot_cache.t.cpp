@@ -0,0 +1,149 @@
+#include "snapshot_cache.h"
+
+#include <stdexcept>
+
+#include <boost/asio/io_context.hpp>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE( "SnapshotCache reuses fresh snapshots", "[snapshot_cache]" ) {
+    int made = 0;
+    std::int64_t sequence = 10;
+
+    auto make = [&]() -> std::optional<SnapshotCache<std::string>::Snapshot> {
+        made++;
+        return SnapshotCache<std::string>::Snapshot{.sequence = sequence, .value = "snapshot " + std::to_string(sequence)};
+    };
+
+    // makes run when test runs executor
+    boost::asio::io_context encoder;
+    auto executor = encoder.get_executor();
+    auto encode = [&] {
+        encoder.restart();
+        encoder.run();
+    };
+
+    SECTION( "snapshot is shared within freshness window" ) {
+        SnapshotCache<std::string> cache{std::chrono::hours(1)};
+
+        auto r1 = cache.request("BTC-USD", 0, executor, make);
+        auto r2 = cache.request("BTC-USD", 0, executor, make);
+
+        REQUIRE( r1 == r2 );
+        REQUIRE( !r1->ready() );
+
+        encode();
+
+        REQUIRE( r1->ready() );
+        REQUIRE( made == 1 );
+
+        sequence = 11;
+        auto r3 = cache.request("BTC-USD", 0, executor, make);
+        encode();
+
+        REQUIRE( made == 1 );
+        REQUIRE( r3->snapshot() == r1->snapshot() );
+        REQUIRE( r3->snapshot()->sequence == 10 );
+        REQUIRE( r3->snapshot()->value == "snapshot 10" );
+
+        // keys are cached separately
+        auto r4 = cache.request("ETH-USD", 0, executor, make);
+        encode();
+
+        REQUIRE( made == 2 );
+        REQUIRE( r4->snapshot()->sequence == 11 );
+    }
+
+    SECTION( "snapshot older than min sequence is made again" ) {
+        SnapshotCache<std::string> cache{std::chrono::hours(1)};
+
+        cache.request("BTC-USD", 0, executor, make);
+        encode();
+        sequence = 11;
+
+        auto request = cache.request("BTC-USD", 11, executor, make);
+        encode();
+
+        REQUIRE( request->snapshot()->sequence == 11 );
+        REQUIRE( made == 2 );
+    }
+
+    SECTION( "pending request is shared even if it may be older than min sequence" ) {
+        SnapshotCache<std::string> cache{std::chrono::hours(1)};
+
+        auto r1 = cache.request("BTC-USD", 0, executor, make);
+        auto r2 = cache.request("BTC-USD", 11, executor, make);
+        encode();
+
+        REQUIRE( r1 == r2 );
+        REQUIRE( r2->snapshot()->sequence == 10 );
+
+        // caller requests again
+        sequence = 11;
+        auto r3 = cache.request("BTC-USD", 11, executor, make);
+        encode();
+
+        REQUIRE( r3->snapshot()->sequence == 11 );
+        REQUIRE( made == 2 );
+    }
+
+    SECTION( "stale snapshot is made again" ) {
+        SnapshotCache<std::string> cache{std::chrono::seconds(0)};
+
+        cache.request("BTC-USD", 0, executor, make);
+        encode();
+        cache.request("BTC-USD", 0, executor, make);
+        encode();
+
+        REQUIRE( made == 2 );
+    }
+
+    SECTION( "missing snapshot is not cached" ) {
+        SnapshotCache<std::string> cache{std::chrono::hours(1)};
+
+        auto missing = cache.request("BTC-USD", 0, executor, []() -> std::optional<SnapshotCache<std::string>::Snapshot> { return std::nullopt; });
+        encode();
+
+        REQUIRE( missing->ready() );
+        REQUIRE( !missing->snapshot() );
+
+        auto request = cache.request("BTC-USD", 0, executor, make);
+        encode();
+
+        REQUIRE( request->snapshot()->sequence == 10 );
+    }
+
+    SECTION( "error of make is rethrown and not cached" ) {
+        SnapshotCache<std::string> cache{std::chrono::hours(1)};
+
+        auto failed = cache.request("BTC-USD", 0, executor, []() -> std::optional<SnapshotCache<std::string>::Snapshot> { throw std::runtime_error("failed"); });
+        encode();
+
+        REQUIRE( failed->ready() );
+        REQUIRE_THROWS_AS( failed->snapshot(), std::runtime_error );
+
+        auto request = cache.request("BTC-USD", 0, executor, make);
+        encode();
+
+        REQUIRE( request->snapshot()->sequence == 10 );
+    }
+
+    SECTION( "watch is invoked once snapshot is ready" ) {
+        SnapshotCache<std::string> cache{std::chrono::hours(1)};
+
+        int invoked = 0;
+        Signal::Watch watch{[&] { invoked++; }};
+
+        auto request = cache.request("BTC-USD", 0, executor, make);
+
+        REQUIRE( request->watch(watch) );
+
+        encode();
+
+        REQUIRE( invoked == 1 );
+
+        // ready request is not watched
+        REQUIRE( !request->watch(watch) );
+        REQUIRE( invoked == 1 );
+    }
+}
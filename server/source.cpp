@@ -1,10 +1,29 @@
 #include "source.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include <boost/log/common.hpp>
 #include <boost/range/adaptors.hpp>
 
+
 namespace {
 
+// maximum number of full channel updates dispatched per wakeup
+constexpr std::size_t dispatch_batch_size = 256;
+
+// interval in which pipeline stages check whether stage before them ended
+constexpr auto stage_poll_interval = std::chrono::milliseconds(100);
+
+// interval of orderbook allocation reports
+constexpr auto report_interval = std::chrono::minutes(1);
+
+// delay before orderbook of stale product is fetched again
+constexpr auto recovery_retry_interval = std::chrono::seconds(1);
+
+// number of fetches of stale orderbook before recovery fails the source
+constexpr std::size_t max_recovery_attempts = 30;
+
 Side map_side(const std::string& src) {
     if (src == "buy") {
         return Side::bid;
@@ -32,7 +51,7 @@ OrderBook map_orderbook(const coinbase::OrderBook& src) {
 
 } // anonymous namespace
 
-FullVisitor::FullVisitor(std::size_t buffer_size): _orderbook_buffer{buffer_size}, _trade_buffer{buffer_size} {
+FullVisitor::FullVisitor(std::size_t buffer_size, WaitStrategy wait): _orderbook_buffer{buffer_size, wait}, _trade_buffer{buffer_size, wait} {
 
 };
 
@@ -94,12 +113,12 @@ void FullVisitor::visit(const coinbase::Full& full, const coinbase::Change& chan
     });
 }
 
-PopResult<OrderBook::Update> FullVisitor::pop_orderbook() {
-    return _orderbook_buffer.pop();
+PopState FullVisitor::drain_orderbook(std::vector<OrderBook::Update>& out, std::size_t max_n, std::chrono::milliseconds timeout) {
+    return _orderbook_buffer.drain(out, max_n, timeout);
 };
 
-PopResult<Trade> FullVisitor::pop_trade() {
-    return _trade_buffer.pop();
+PopState FullVisitor::drain_trade(std::vector<Trade>& out, std::size_t max_n, std::chrono::milliseconds timeout) {
+    return _trade_buffer.drain(out, max_n, timeout);
 }
 
 void FullVisitor::push_orderbook_update(const coinbase::Full& full, OrderBook::Update&& update) {
@@ -126,26 +145,66 @@ bool Source::find_product(const std::string& product_id) const {
     return std::find(_products.begin(), _products.end(), product_id) != _products.end();
 }
 
-CoinbaseSource::CoinbaseSource(boost::log::sources::logger_mt& logger, coinbase::Client& client, std::vector<std::string> products, std::size_t subscriber_buffer_size, std::size_t channel_buffer_size): Source{products}, _logger{logger}, _client{client}, _full_visitor{channel_buffer_size}, _orderbook_dispatcher{subscriber_buffer_size}, _trade_dispatcher{subscriber_buffer_size} {
+CoinbaseSource::CoinbaseSource(boost::log::sources::logger_mt& logger, coinbase::Client& client, std::vector<std::string> products, WaitStrategy wait, std::size_t apply_workers, std::size_t fetch_concurrency, std::size_t subscriber_buffer_size, std::size_t channel_buffer_size): Source{products}, _logger{logger}, _client{client}, _full_visitor{channel_buffer_size, wait}, _orderbook_dispatcher{subscriber_buffer_size, &OrderBook::Update::product_id, wait}, _trade_dispatcher{subscriber_buffer_size, &Trade::product_id, wait}, _top_of_book_dispatcher{subscriber_buffer_size, &TopOfBook::product_id, wait}, _level2_dispatcher{subscriber_buffer_size, &Level2::product_id, wait}, _fetch_concurrency{std::max<std::size_t>(fetch_concurrency, 1)} {
+    for (std::size_t i = 0; i < std::min(apply_workers, this->products().size()); i++) {
+        _apply_buffers.push_back(std::make_unique<RingBuffer<OrderBook::Update>>(channel_buffer_size, wait));
+    };
+
+    if (_apply_buffers.empty()) {
+        return;
+    };
+
+    // worker keeps order of updates of its products, so sequence of each product is preserved
+    for (std::size_t i = 0; i < this->products().size(); i++) {
+        _product_buffers.emplace(this->products()[i], _apply_buffers[i % _apply_buffers.size()].get());
+    };
 
 };
 
-bool CoinbaseSource::get_orderbook(const std::string& product_id, std::function<void (const OrderBook&)> callback) {
-    std::unique_lock lock{_mtx};
+CoinbaseSource::~CoinbaseSource() {
+    std::unique_lock lock{_recovery_mtx};
+    _stopping = true;
+    _recovery_cv.notify_all();
+};
 
-    if (!_ready) {
-        return false;
+std::shared_ptr<const OrderBook> CoinbaseSource::get_orderbook(const std::string& product_id) {
+    if (!ready()) {
+        return nullptr;
     };
 
-    return _orderbooks->get(product_id, callback);
+    return _orderbooks->snapshot(product_id);
 };
 
-std::shared_ptr<Subscriber<OrderBook::Update>> CoinbaseSource::subscribe_orderbook(const std::string& product_id) {
-    return _orderbook_dispatcher.subscribe([=](const auto& orderbook) { return orderbook.product_id == product_id; });
+std::optional<OrderBook::Depth> CoinbaseSource::get_depth(const std::string& product_id, std::size_t n) {
+    if (!ready()) {
+        return std::nullopt;
+    };
+
+    return _orderbooks->depth(product_id, n);
+};
+
+std::shared_ptr<Subscriber<OrderBook::Update>> CoinbaseSource::subscribe_orderbook(const std::string& product_id, std::size_t replay) {
+    return _orderbook_dispatcher.subscribe(product_id, replay);
 };
 
 std::shared_ptr<Subscriber<Trade>> CoinbaseSource::subscribe_trade(const std::string& product_id) {
-    return _trade_dispatcher.subscribe([=](const auto& trade) { return trade.product_id == product_id; });
+    return _trade_dispatcher.subscribe(product_id);
+};
+
+std::optional<TopOfBook> CoinbaseSource::get_top_of_book(const std::string& product_id) {
+    if (!ready()) {
+        return std::nullopt;
+    };
+
+    return _orderbooks->top(product_id);
+};
+
+std::shared_ptr<Subscriber<TopOfBook>> CoinbaseSource::subscribe_top_of_book(const std::string& product_id) {
+    return _top_of_book_dispatcher.subscribe(product_id);
+};
+
+std::shared_ptr<Subscriber<Level2>> CoinbaseSource::subscribe_level2(const std::string& product_id) {
+    return _level2_dispatcher.subscribe(product_id);
 };
 
 bool CoinbaseSource::ready() {
@@ -157,27 +216,47 @@ bool CoinbaseSource::ready() {
 void CoinbaseSource::run() {
     std::vector<std::future<void>> tasks;
 
-    tasks.emplace_back(subscribe_full());
+    auto subscription = subscribe_full();
 
     fetch_orderbooks();
 
     tasks.emplace_back(std::async(std::launch::async, [this] { dispatch_orderbook(); }));
+    for (auto& buffer: _apply_buffers) {
+        tasks.emplace_back(std::async(std::launch::async, [this, &buffer] { apply_worker(*buffer); }));
+    };
     tasks.emplace_back(std::async(std::launch::async, [this] { dispatch_trade(); }));
 
+    auto next_report = std::chrono::steady_clock::now() + report_interval;
+
     while (tasks.size()) {
-        for (auto it = tasks.begin(); it != tasks.end(); it++) {
-            auto& task = *it;
+        if (std::chrono::steady_clock::now() >= next_report) {
+            report();
+            next_report += report_interval;
+        };
+
+        // stages drain updates received before subscription ended and then exit
+        if (subscription.valid() && subscription.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            _receiving = false;
+            subscription.get();
+        };
 
-            auto status = task.wait_for(std::chrono::milliseconds(100));
+        for (auto it = tasks.begin(); it != tasks.end();) {
+            auto status = it->wait_for(stage_poll_interval);
             if (status != std::future_status::ready) {
+                it++;
                 continue;
             };
 
-            task.get();
+            it->get();
 
-            tasks.erase(it);
+            it = tasks.erase(it);
         };
+
+        reap_recoveries();
     };
+
+    // updates buffered by products that were stale are published once their recoveries finish
+    reap_recoveries(true);
 };
 
 std::future<void> CoinbaseSource::subscribe_full() {
@@ -192,13 +271,34 @@ std::future<void> CoinbaseSource::subscribe_full() {
 };
 
 void CoinbaseSource::fetch_orderbooks() {
+    std::mutex mtx;
     std::unordered_map<std::string, OrderBook> orderbooks;
+    std::atomic<std::size_t> next{0};
+
+    // fetchers take next product until all are fetched, client reuses connections between fetches
+    std::vector<std::future<void>> fetchers;
+    for (std::size_t i = 0; i < std::min(_fetch_concurrency, products().size()); i++) {
+        fetchers.emplace_back(std::async(std::launch::async, [&] {
+            try {
+                for (auto n = next++; n < products().size(); n = next++) {
+                    const auto& product = products()[n];
+                    auto orderbook = map_orderbook(_client.get_orderbook(product));
+
+                    BOOST_LOG(_logger) << "retrieved orderbook " << product;
+
+                    std::unique_lock lock{mtx};
+                    orderbooks.emplace(product, std::move(orderbook));
+                };
+            } catch (...) {
+                // other fetchers stop after their current product
+                next = products().size();
+                throw;
+            };
+        }));
+    };
 
-    for (auto product: products()) {
-        auto orderbook = _client.get_orderbook(product);
-        orderbooks.emplace(product, map_orderbook(orderbook));
-
-        BOOST_LOG(_logger) << "retrieved orderbook " << product;
+    for (auto& fetcher: fetchers) {
+        fetcher.get();
     };
 
     std::unique_lock lock{_mtx};
@@ -208,35 +308,232 @@ void CoinbaseSource::fetch_orderbooks() {
 
 void CoinbaseSource::dispatch_orderbook() {
     try {
+        std::vector<OrderBook::Update> batch;
+        batch.reserve(dispatch_batch_size);
+
         while (true) {
-            auto [res, state] = _full_visitor.pop_orderbook();
+            batch.clear();
+
+            // flag is read before drain, so that timeout after subscription ended means that buffer is drained
+            auto receiving = _receiving.load();
+
+            auto state = _full_visitor.drain_orderbook(batch, dispatch_batch_size, stage_poll_interval);
             if (state == PopState::overflow) {
                 throw std::invalid_argument("orderbook buffer overflow");
             };
 
-            auto update = _orderbooks->update(*res);
-            if (!update) {
+            if (state == PopState::timeout) {
+                if (!receiving) {
+                    break;
+                };
+                continue;
+            };
+
+            if (_apply_buffers.empty()) {
+                apply_orderbook(batch);
                 continue;
             };
 
-            _orderbook_dispatcher.dispatch(*update);
+            // route updates to apply workers, each orderbook is only written by worker of its product
+            for (auto& res: batch) {
+                if (!_product_buffers.at(res.product_id)->push(std::move(res))) {
+                    throw std::invalid_argument("apply buffer overflow");
+                };
+            };
         };
+
+        _routing = false;
     } catch (...) {
+        _routing = false;
         std::throw_with_nested(std::runtime_error("dispatch_orderbook() failed"));
     };
 };
 
+void CoinbaseSource::apply_worker(RingBuffer<OrderBook::Update>& buffer) {
+    try {
+        std::vector<OrderBook::Update> batch;
+        batch.reserve(dispatch_batch_size);
+
+        while (true) {
+            batch.clear();
+
+            auto routing = _routing.load();
+
+            auto state = buffer.drain(batch, dispatch_batch_size, stage_poll_interval);
+            if (state == PopState::overflow) {
+                throw std::invalid_argument("apply buffer overflow");
+            };
+
+            if (state == PopState::timeout) {
+                if (!routing) {
+                    return;
+                };
+                continue;
+            };
+
+            apply_orderbook(batch);
+        };
+    } catch (...) {
+        std::throw_with_nested(std::runtime_error("apply_worker() failed"));
+    };
+};
+
+void CoinbaseSource::apply_orderbook(const std::vector<OrderBook::Update>& batch) {
+    for (const auto& res: batch) {
+        std::optional<OrderBook::Update> update;
+        try {
+            update = _orderbooks->update(res);
+        } catch (SequenceGap& gap) {
+            // only the product that lost updates is recovered, others keep streaming
+            BOOST_LOG(_logger) << gap.what();
+
+            auto product_id = gap.stale.product_id;
+            publish_orderbook(std::move(gap.stale));
+
+            std::unique_lock lock{_recovery_mtx};
+            _recoveries.push_back(std::async(std::launch::async, [this, product_id] { recover_orderbook(product_id); }));
+            continue;
+        };
+
+        if (!update) {
+            continue;
+        };
+
+        publish_orderbook(std::move(*update));
+    };
+
+    _applied.fetch_add(batch.size(), std::memory_order_relaxed);
+};
+
+void CoinbaseSource::publish_orderbook(OrderBook::Update&& update) {
+    if (update.top) {
+        _top_of_book_dispatcher.dispatch(std::move(*update.top));
+        update.top.reset();
+    };
+
+    // levels are computed once by update and shared by all level2 streams of product
+    if (update.levels) {
+        _level2_dispatcher.dispatch(std::move(*update.levels));
+        update.levels.reset();
+    };
+
+    _orderbook_dispatcher.dispatch(std::move(update));
+};
+
+void CoinbaseSource::recover_orderbook(const std::string& product_id) {
+    // updates of stale product are buffered and not published by apply worker,
+    // so recovery publishes them until it catches up and the product is live again
+    try {
+        auto dropped = _orderbooks->dropped(product_id);
+
+        for (std::size_t attempt = 0; attempt < max_recovery_attempts; attempt++) {
+            // retries wait unless source is being destroyed
+            if (attempt > 0) {
+                std::unique_lock lock{_recovery_mtx};
+                if (_recovery_cv.wait_for(lock, recovery_retry_interval, [this] { return _stopping; })) {
+                    return;
+                };
+            };
+
+            std::optional<OrderBook> orderbook;
+            try {
+                orderbook.emplace(map_orderbook(_client.get_orderbook(product_id)));
+            } catch (const std::exception& exc) {
+                BOOST_LOG(_logger) << "failed to fetch orderbook " << product_id << ": " << exc.what();
+                continue;
+            };
+
+            if (auto n = _orderbooks->dropped(product_id); n != dropped) {
+                BOOST_LOG(_logger) << "dropped " << n - dropped << " buffered updates of stale orderbook " << product_id;
+                dropped = n;
+            };
+
+            auto resync = _orderbooks->reset(product_id, std::move(*orderbook));
+            if (!resync) {
+                BOOST_LOG(_logger) << "retrieved orderbook " << product_id << " is older than buffered updates";
+                continue;
+            };
+
+            BOOST_LOG(_logger) << "resynced orderbook " << product_id << " at sequence " << resync->sequence;
+            publish_orderbook(std::move(*resync));
+
+            try {
+                for (auto updates = _orderbooks->resume(product_id); !updates.empty(); updates = _orderbooks->resume(product_id)) {
+                    for (auto& update: updates) {
+                        publish_orderbook(std::move(update));
+                    };
+                };
+            } catch (SequenceGap& gap) {
+                BOOST_LOG(_logger) << gap.what();
+                publish_orderbook(std::move(gap.stale));
+                continue;
+            };
+
+            return;
+        };
+
+        throw std::runtime_error("orderbook " + product_id + " not recovered after " + std::to_string(max_recovery_attempts) + " attempts");
+    } catch (...) {
+        std::throw_with_nested(std::runtime_error("recover_orderbook() failed"));
+    };
+};
+
+void CoinbaseSource::reap_recoveries(bool all) {
+    std::vector<std::future<void>> finished;
+
+    {
+        std::unique_lock lock{_recovery_mtx};
+
+        auto it = std::partition(_recoveries.begin(), _recoveries.end(), [all](const auto& recovery) {
+            return !all && recovery.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+        });
+
+        std::move(it, _recoveries.end(), std::back_inserter(finished));
+        _recoveries.erase(it, _recoveries.end());
+    }
+
+    // failed recovery fails the source as any other task
+    for (auto& recovery: finished) {
+        recovery.get();
+    };
+};
+
 void CoinbaseSource::dispatch_trade() {
     try {
+        std::vector<Trade> batch;
+        batch.reserve(dispatch_batch_size);
+
         while (true) {
-            auto [res, state] = _full_visitor.pop_trade();
+            batch.clear();
+
+            auto receiving = _receiving.load();
+
+            auto state = _full_visitor.drain_trade(batch, dispatch_batch_size, stage_poll_interval);
             if (state == PopState::overflow) {
                 throw std::invalid_argument("trade buffer overflow");
             };
 
-            _trade_dispatcher.dispatch(*res);
+            if (state == PopState::timeout) {
+                if (!receiving) {
+                    return;
+                };
+                continue;
+            };
+
+            for (auto& trade: batch) {
+                _trade_dispatcher.dispatch(std::move(trade));
+            };
         };
     } catch (...) {
         std::throw_with_nested(std::runtime_error("dispatch_trade() failed"));
     };
-}
\ No newline at end of file
+}
+
+void CoinbaseSource::report() {
+    // orderbook pools stop going to the heap once orderbooks reach their working size
+    auto applied = _applied.load(std::memory_order_relaxed);
+    auto allocations = _orderbooks->allocations();
+
+    BOOST_LOG(_logger) << "applied " << applied << " orderbook updates, orderbook pools made " << allocations << " allocations ("
+        << (applied ? static_cast<double>(allocations) / applied : 0.0) << " per update)";
+};
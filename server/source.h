@@ -1,6 +1,8 @@
 #ifndef SERVER_SOURCE_H
 #define SERVER_SOURCE_H 1
 
+#include <atomic>
+#include <condition_variable>
 #include <future>
 #include <mutex>
 
@@ -10,6 +12,7 @@
 #include "orderbook.h"
 #include "ring_buffer.h"
 #include "trade.h"
+#include "wait.h"
 
 #include "coinbase/client.h"
 #include "coinbase/full.h"
@@ -21,9 +24,18 @@ public:
     inline const std::vector<std::string>& products() const { return _products; };
     bool find_product(const std::string& product) const;
 
-    virtual bool get_orderbook(const std::string& product_id, std::function<void (const OrderBook&)> callback) = 0;
-    virtual std::shared_ptr<Subscriber<OrderBook::Update>> subscribe_orderbook(const std::string& product_id) = 0;
+    // get_orderbook returns immutable snapshot of orderbook or nullptr if it is not available
+    // Getters return nothing also while orderbook is stale, ie. until it is fetched again after lost updates.
+    virtual std::shared_ptr<const OrderBook> get_orderbook(const std::string& product_id) = 0;
+    virtual std::optional<OrderBook::Depth> get_depth(const std::string& product_id, std::size_t n) = 0;
+    virtual std::optional<TopOfBook> get_top_of_book(const std::string& product_id) = 0;
+    // subscribe_orderbook subscribes to updates of product, replaying up to replay of the latest ones that are still buffered
+    virtual std::shared_ptr<Subscriber<OrderBook::Update>> subscribe_orderbook(const std::string& product_id, std::size_t replay = 0) = 0;
     virtual std::shared_ptr<Subscriber<Trade>> subscribe_trade(const std::string& product_id) = 0;
+    // subscribe_top_of_book subscribes to changes of best bid or ask
+    virtual std::shared_ptr<Subscriber<TopOfBook>> subscribe_top_of_book(const std::string& product_id) = 0;
+    // subscribe_level2 subscribes to changes of price levels within level2_depth best ones
+    virtual std::shared_ptr<Subscriber<Level2>> subscribe_level2(const std::string& product_id) = 0;
 
     virtual void run() = 0;
     virtual bool ready() = 0;
@@ -34,10 +46,10 @@ private:
 
 class FullVisitor: public coinbase::FullVisitor {
 public:
-    FullVisitor(std::size_t buffer_size);
+    FullVisitor(std::size_t buffer_size, WaitStrategy wait = {});
 
-    PopResult<OrderBook::Update> pop_orderbook();
-    PopResult<Trade> pop_trade();
+    PopState drain_orderbook(std::vector<OrderBook::Update>& out, std::size_t max_n, std::chrono::milliseconds timeout);
+    PopState drain_trade(std::vector<Trade>& out, std::size_t max_n, std::chrono::milliseconds timeout);
 
     void visit(const coinbase::Full& full, const coinbase::Received& received) override;
     void visit(const coinbase::Full& full, const coinbase::Open& open) override;
@@ -55,12 +67,24 @@ private:
 
 class CoinbaseSource: public Source {
 public:
-    CoinbaseSource(boost::log::sources::logger_mt& logger, coinbase::Client& client, std::vector<std::string> products, std::size_t subscriber_buffer_size = 1024, std::size_t channel_buffer_size = 65536);
-
-    bool get_orderbook(const std::string& product_id, std::function<void (const OrderBook&)> callback) override;
-    std::shared_ptr<Subscriber<OrderBook::Update>> subscribe_orderbook(const std::string& product_id) override;
+    // wait is used by dispatchers and subscribers, busy-spin trades cpu for latency
+    // apply_workers is number of threads that apply updates, products are assigned to them round-robin
+    // With no workers updates are applied by the thread that routes them.
+    // fetch_concurrency limits number of orderbook snapshots fetched at once.
+    CoinbaseSource(boost::log::sources::logger_mt& logger, coinbase::Client& client, std::vector<std::string> products, WaitStrategy wait = {}, std::size_t apply_workers = 0, std::size_t fetch_concurrency = 4, std::size_t subscriber_buffer_size = 1024, std::size_t channel_buffer_size = 65536);
+
+    // cancels retries of orderbook recoveries and waits for them
+    ~CoinbaseSource();
+
+    std::shared_ptr<const OrderBook> get_orderbook(const std::string& product_id) override;
+    std::optional<OrderBook::Depth> get_depth(const std::string& product_id, std::size_t n) override;
+    std::optional<TopOfBook> get_top_of_book(const std::string& product_id) override;
+    std::shared_ptr<Subscriber<OrderBook::Update>> subscribe_orderbook(const std::string& product_id, std::size_t replay = 0) override;
     std::shared_ptr<Subscriber<Trade>> subscribe_trade(const std::string& product_id) override;
+    std::shared_ptr<Subscriber<TopOfBook>> subscribe_top_of_book(const std::string& product_id) override;
+    std::shared_ptr<Subscriber<Level2>> subscribe_level2(const std::string& product_id) override;
 
+    // run returns once full channel subscription ends and pipeline applied all of its updates, including recovered ones
     void run() override;
     bool ready() override;
 
@@ -72,14 +96,43 @@ private:
     FullVisitor _full_visitor;
     Dispatcher<OrderBook::Update> _orderbook_dispatcher;
     Dispatcher<Trade> _trade_dispatcher;
+    Dispatcher<TopOfBook> _top_of_book_dispatcher;
+    Dispatcher<Level2> _level2_dispatcher;
 
     std::unique_ptr<OrderBooks> _orderbooks;
-    bool _ready;
+    bool _ready = false;
+
+    std::size_t _fetch_concurrency;
+
+    // queues of apply workers and worker of each product, empty if updates are applied by dispatch thread
+    std::vector<std::unique_ptr<RingBuffer<OrderBook::Update>>> _apply_buffers;
+    std::unordered_map<std::string, RingBuffer<OrderBook::Update>*> _product_buffers;
+
+    // number of updates applied to orderbooks
+    std::atomic<std::size_t> _applied{0};
+
+    // cleared when full channel subscription ends and when routing stage exits, stages downstream then stop once drained
+    std::atomic<bool> _receiving{true};
+    std::atomic<bool> _routing{true};
+
+    // background recoveries of products that lost updates, finished ones are reaped by run
+    // Declared last so that recoveries are joined before anything they use is destroyed.
+    std::mutex _recovery_mtx;
+    std::condition_variable _recovery_cv;
+    bool _stopping = false;
+    std::vector<std::future<void>> _recoveries;
 
     std::future<void> subscribe_full();
     void fetch_orderbooks();
     void dispatch_orderbook();
+    void apply_worker(RingBuffer<OrderBook::Update>& buffer);
+    void apply_orderbook(const std::vector<OrderBook::Update>& batch);
+    void publish_orderbook(OrderBook::Update&& update);
+    void recover_orderbook(const std::string& product_id);
+    // reap_recoveries waits for finished recoveries, or for all of them
+    void reap_recoveries(bool all = false);
     void dispatch_trade();
+    void report();
 };
 
 #endif
\ No newline at end of file
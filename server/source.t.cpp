@@ -0,0 +1,191 @@
+#include "source.h"
+
+#include <algorithm>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+// FakeClient serves empty orderbooks and feeds open orders of all products interleaved, sequences start at 1
+// Feed skips sequence skip if it is set, orderbooks fetched again are then snapshots at that sequence.
+// Feed pauses after the update that follows the gap until resynced returns true.
+class FakeClient: public coinbase::Client {
+public:
+    explicit FakeClient(std::int64_t n, std::int64_t skip = 0): n{n}, skip{skip} {};
+
+    std::function<bool()> resynced;
+
+    coinbase::OrderBook get_orderbook(std::string product) override {
+        std::unique_lock lock{mtx};
+        if (skip == 0 || fetched.insert(product).second) {
+            return {.sequence = 0};
+        };
+
+        coinbase::OrderBook orderbook{.sequence = skip};
+        for (std::int64_t sequence = 1; sequence <= skip; sequence++) {
+            auto bid = sequence % 2;
+
+            (bid ? orderbook.bids : orderbook.asks).push_back(coinbase::OrderBook::Entry{
+                .price = Decimal(bid ? "100" : "101"),
+                .size = Decimal("1"),
+                .order_id = OrderId(0, sequence),
+            });
+        };
+
+        return orderbook;
+    };
+
+    std::future<void> subscribe_full(std::vector<std::string> products, std::function<void(const coinbase::Full&)> callback) override {
+        return std::async(std::launch::async, [this, products, callback] {
+            for (std::int64_t sequence = 1; sequence <= n; sequence++) {
+                if (sequence == skip) {
+                    continue;
+                };
+
+                for (std::size_t i = 0; i < products.size(); i++) {
+                    auto bid = sequence % 2;
+
+                    callback(coinbase::Full{
+                        .type = coinbase::Full::Type::Open,
+                        .product_id = products[i],
+                        .sequence = sequence,
+                        .side = bid ? "buy" : "sell",
+                        .payload = coinbase::Open{
+                            .order_id = OrderId(i, sequence),
+                            .price = Decimal(bid ? "100" : "101"),
+                            .remaining_size = Decimal("1"),
+                        },
+                    });
+                };
+
+                while (sequence == skip + 1 && resynced && !resynced()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                };
+            };
+        });
+    };
+
+private:
+    const std::int64_t n;
+    const std::int64_t skip;
+
+    std::mutex mtx;
+    std::unordered_set<std::string> fetched;
+};
+
+} // anonymous namespace
+
+TEST_CASE( "CoinbaseSource applies interleaved products in sequence order", "[source]" ) {
+    auto apply_workers = GENERATE(std::size_t{0}, std::size_t{2});
+    const std::int64_t n = 1000;
+
+    std::vector<std::string> products{"BTC-USD", "ETH-USD", "LTC-USD"};
+
+    boost::log::sources::logger_mt logger;
+    FakeClient client{n};
+    CoinbaseSource source{logger, client, products, {}, apply_workers, 4, 4096};
+
+    std::vector<std::shared_ptr<Subscriber<OrderBook::Update>>> subscribers;
+    for (const auto& product: products) {
+        subscribers.push_back(source.subscribe_orderbook(product));
+    };
+
+    // run returns once fake feed ended and all of its updates were applied
+    source.run();
+
+    std::vector<std::int64_t> expected;
+    for (std::int64_t sequence = 1; sequence <= n; sequence++) {
+        expected.push_back(sequence);
+    };
+
+    for (std::size_t i = 0; i < products.size(); i++) {
+        std::vector<Message<OrderBook::Update>> updates;
+        REQUIRE( subscribers[i]->drain(updates, 2 * n, std::chrono::seconds(0)) == PopState::valid );
+
+        std::vector<std::int64_t> sequences;
+        for (const auto& update: updates) {
+            REQUIRE( update->value().product_id == products[i] );
+            sequences.push_back(update->value().sequence);
+        };
+
+        REQUIRE( sequences == expected );
+
+        auto orderbook = source.get_orderbook(products[i]);
+        REQUIRE( orderbook->sequence() == n );
+        REQUIRE( orderbook->bids().size() == n / 2 );
+        REQUIRE( orderbook->asks().size() == n / 2 );
+    };
+}
+
+TEST_CASE( "CoinbaseSource resyncs product that skipped sequence", "[source]" ) {
+    auto apply_workers = GENERATE(std::size_t{0}, std::size_t{2});
+    const std::int64_t n = 1000;
+    const std::int64_t skip = 500;
+
+    std::vector<std::string> products{"BTC-USD", "ETH-USD"};
+
+    boost::log::sources::logger_mt logger;
+    FakeClient client{n, skip};
+    CoinbaseSource source{logger, client, products, {}, apply_workers, 4, 4096};
+
+    std::vector<std::shared_ptr<Subscriber<OrderBook::Update>>> subscribers;
+    for (const auto& product: products) {
+        subscribers.push_back(source.subscribe_orderbook(product));
+    };
+
+    // fetched orderbook is available again once it replaced stale one
+    client.resynced = [&] {
+        return std::all_of(products.begin(), products.end(), [&](const auto& product) {
+            auto orderbook = source.get_orderbook(product);
+            return orderbook && orderbook->sequence() > skip;
+        });
+    };
+
+    // run returns once recoveries published updates buffered while products were stale
+    source.run();
+
+    for (std::size_t i = 0; i < products.size(); i++) {
+        std::vector<Message<OrderBook::Update>> updates;
+        REQUIRE( subscribers[i]->drain(updates, 2 * n, std::chrono::seconds(0)) == PopState::valid );
+        REQUIRE( updates.size() == n );
+
+        // updates before gap are followed by stale update at the last applied sequence
+        for (std::int64_t sequence = 1; sequence < skip; sequence++) {
+            const auto& update = updates[sequence - 1]->value();
+            REQUIRE( update.sequence == sequence );
+            REQUIRE_FALSE( update.stale );
+            REQUIRE_FALSE( update.resync );
+        };
+
+        const auto& stale = updates[skip - 1]->value();
+        REQUIRE( stale.sequence == skip - 1 );
+        REQUIRE( stale.stale );
+        REQUIRE_FALSE( stale.bid );
+        REQUIRE_FALSE( stale.ask );
+
+        // resync carries sequence of fetched orderbook with update buffered after gap, the following updates continue from it
+        const auto& resync = updates[skip]->value();
+        REQUIRE( resync.sequence == skip + 1 );
+        REQUIRE( resync.resync );
+        REQUIRE_FALSE( resync.stale );
+
+        for (std::int64_t sequence = skip + 2; sequence <= n; sequence++) {
+            const auto& update = updates[sequence - 1]->value();
+            REQUIRE( update.sequence == sequence );
+            REQUIRE_FALSE( update.stale );
+            REQUIRE_FALSE( update.resync );
+        };
+
+        auto orderbook = source.get_orderbook(products[i]);
+        REQUIRE( orderbook != nullptr );
+        REQUIRE( orderbook->sequence() == n );
+        REQUIRE( orderbook->bids().size() == n / 2 );
+        REQUIRE( orderbook->asks().size() == n / 2 );
+    };
+}
@@ -0,0 +1,149 @@
+#include "stream_writer.h"
+
+#include <exception>
+
+#include <boost/asio/post.hpp>
+
+StreamWriter* StreamWriter::start(Executor executor, std::unique_ptr<Pump> pump) {
+    auto writer = std::shared_ptr<StreamWriter>(new StreamWriter(executor, std::move(pump)));
+    writer->_self = writer;
+
+    // writes started before reactor is bound to call are held by grpc until it is
+    writer->schedule();
+
+    return writer.get();
+};
+
+StreamWriter::StreamWriter(Executor executor, std::unique_ptr<Pump> pump):
+    _executor{executor}, _pump{std::move(pump)}, _watch{[this] { schedule(); }}, _timer{executor} {
+
+};
+
+void StreamWriter::schedule() {
+    // watch may be invoked by dispatcher while reactor is being destroyed
+    auto self = weak_from_this().lock();
+    if (!self) {
+        return;
+    };
+
+    boost::asio::post(_executor, [self = std::move(self)] { self->run(); });
+};
+
+void StreamWriter::run() {
+    std::unique_lock lock{_mtx};
+
+    if (_finished) {
+        return;
+    };
+
+    // pump continues once frames are written, cancelled write completes as well
+    if (_writing) {
+        _pump->receive(_watch);
+        return;
+    };
+
+    while (true) {
+        if (_cancelled) {
+            finish(lock, grpc::Status::CANCELLED);
+            return;
+        };
+
+        _frames.clear();
+        _next = 0;
+
+        try {
+            _status = _started ? _pump->next(_frames) : _pump->start(_frames);
+            _started = true;
+        } catch (const std::exception& exc) {
+            _frames.clear();
+            _status = grpc::Status(grpc::StatusCode::UNKNOWN, exc.what());
+        };
+
+        if (!_frames.empty()) {
+            _pump->receive(_watch);
+            write(lock);
+            return;
+        };
+
+        if (_status) {
+            finish(lock, *_status);
+            return;
+        };
+
+        // timer that is replaced cancels its previous wait
+        if (auto deadline = _pump->deadline()) {
+            _timer.expires_at(*deadline);
+            _timer.async_wait([self = shared_from_this()](const auto& error) {
+                if (!error) {
+                    self->run();
+                };
+            });
+        };
+
+        // message that arrived meanwhile is taken right away
+        if (_pump->watch(_watch)) {
+            return;
+        };
+    };
+};
+
+void StreamWriter::write(std::unique_lock<std::mutex>& lock) {
+    // stream is flushed only after the last frame
+    auto options = grpc::WriteOptions();
+    if (_next + 1 < _frames.size()) {
+        options.set_buffer_hint();
+    };
+
+    auto buffer = _frames[_next].buffer;
+    _writing = true;
+
+    lock.unlock();
+    StartWrite(buffer, options);
+};
+
+void StreamWriter::finish(std::unique_lock<std::mutex>& lock, grpc::Status status) {
+    _finished = true;
+    _timer.cancel();
+
+    lock.unlock();
+    Finish(status);
+};
+
+void StreamWriter::OnWriteDone(bool ok) {
+    std::unique_lock lock{_mtx};
+
+    _writing = false;
+
+    // stream is broken, client went away
+    if (!ok) {
+        finish(lock, grpc::Status::CANCELLED);
+        return;
+    };
+
+    if (++_next < _frames.size()) {
+        write(lock);
+        return;
+    };
+
+    if (_status) {
+        finish(lock, *_status);
+        return;
+    };
+
+    lock.unlock();
+    schedule();
+};
+
+void StreamWriter::OnCancel() {
+    std::unique_lock lock{_mtx};
+    _cancelled = true;
+    lock.unlock();
+
+    // waiting stream is finished right away, pending write completes as not ok and finishes it
+    schedule();
+};
+
+void StreamWriter::OnDone() {
+    // the last reference may be released here, reactor must not be touched afterwards
+    auto self = std::move(_self);
+};
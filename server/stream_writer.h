@@ -0,0 +1,99 @@
+#ifndef STREAM_WRITER_H
+#define STREAM_WRITER_H 1
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include <grpcpp/support/byte_buffer.h>
+#include <grpcpp/support/server_callback.h>
+#include <grpcpp/support/status.h>
+
+#include "wait.h"
+
+// StreamWriter is reactor of server streaming call that writes frames produced by its pump.
+// Pump runs on shared executor whenever stream can make progress: when call starts, when frames were written,
+// when watched subscriber receives message, when deadline of pump passes and when call is cancelled.
+// Next write is started from completion of the previous one, so stream waiting for messages or for client holds no thread.
+class StreamWriter final: public grpc::ServerWriteReactor<grpc::ByteBuffer>, public std::enable_shared_from_this<StreamWriter> {
+public:
+    using Executor = boost::asio::thread_pool::executor_type;
+
+    // Frame is encoded message, owner keeps buffer alive until it is written
+    // Frames of dispatched messages are owned by message, so that buffer shared by all streams is written without copying it.
+    struct Frame {
+        std::shared_ptr<const void> owner;
+        const grpc::ByteBuffer* buffer;
+    };
+
+    // Pump produces frames of single stream, it is never run concurrently with itself and it must not block
+    class Pump {
+    public:
+        virtual ~Pump() = default;
+
+        // start appends the first frames of stream, it is run once before next
+        // Returns status to finish call with after frames are written, or nothing to continue.
+        virtual std::optional<grpc::Status> start(std::vector<Frame>& out) { return std::nullopt; };
+
+        // next appends frames that are available to out, it returns status as start
+        // If no frames were appended, pump runs again once watch is invoked or deadline passes.
+        virtual std::optional<grpc::Status> next(std::vector<Frame>& out) = 0;
+
+        // watch arms watch to be invoked once next can append frames, returns false if it already can
+        virtual bool watch(Signal::Watch& watch) = 0;
+
+        // deadline is when next has to run again even if watch was not invoked
+        virtual std::optional<std::chrono::steady_clock::time_point> deadline() { return std::nullopt; };
+
+        // receive takes messages while frames are written and arms watch for more
+        // Pump that does not keep up with messages meanwhile (ie. to conflate them) does nothing.
+        virtual void receive(Signal::Watch& watch) { };
+    };
+
+    // start creates reactor of call served by pump, reactor deletes itself once call is done
+    static StreamWriter* start(Executor executor, std::unique_ptr<Pump> pump);
+
+    void OnWriteDone(bool ok) override;
+    void OnCancel() override;
+    void OnDone() override;
+
+private:
+    StreamWriter(Executor executor, std::unique_ptr<Pump> pump);
+
+    Executor _executor;
+
+    std::mutex _mtx;
+    // pump is declared before watch, so that watch is disarmed before subscriber of pump is released
+    std::unique_ptr<Pump> _pump;
+    Signal::Watch _watch;
+    boost::asio::steady_timer _timer;
+
+    bool _started = false;
+    bool _cancelled = false;
+    bool _finished = false;
+
+    // frames being written, frame at _next is written while _writing is set
+    std::vector<Frame> _frames;
+    std::size_t _next = 0;
+    bool _writing = false;
+    // status that call is finished with once frames are written
+    std::optional<grpc::Status> _status;
+
+    // reference held by grpc until call is done
+    std::shared_ptr<StreamWriter> _self;
+
+    // schedule runs pump on executor
+    void schedule();
+    void run();
+
+    // write starts write of the next frame, finish ends call, both release lock before calling into grpc
+    void write(std::unique_lock<std::mutex>& lock);
+    void finish(std::unique_lock<std::mutex>& lock, grpc::Status status);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H 1
+
+#include <chrono>
+#include <optional>
+
+// Throttle limits stream to at most one message per interval, carrying the latest change.
+// Change offered within interval since the last taken one is held back and replaced by later ones,
+// it is taken once interval passes. Time is passed in by caller, so that it can be tested.
+template <typename T>
+class Throttle {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Throttle(Clock::duration interval): _interval(interval) {};
+
+    inline Clock::duration interval() const { return _interval; };
+
+    // start marks that the first message was written at now
+    void start(Clock::time_point now) {
+        _next = now + _interval;
+    };
+
+    // offer replaces held back change with value
+    void offer(T value) {
+        _pending = std::move(value);
+    };
+
+    // take returns held back change if interval since the last taken one passed
+    std::optional<T> take(Clock::time_point now) {
+        if (!_pending || now < _next) {
+            return std::nullopt;
+        };
+
+        auto value = std::move(_pending);
+        _pending.reset();
+        _next = now + _interval;
+
+        return value;
+    };
+
+    // deadline returns when held back change can be taken
+    std::optional<Clock::time_point> deadline() const {
+        if (!_pending) {
+            return std::nullopt;
+        };
+
+        return _next;
+    };
+
+private:
+    const Clock::duration _interval;
+
+    Clock::time_point _next;
+
+    // the latest change that is held back
+    std::optional<T> _pending;
+};
+
+#endif
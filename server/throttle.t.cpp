@@ -0,0 +1,61 @@
+#include "throttle.h"
+
+#include <catch2/catch.hpp>
+
+TEST_CASE( "Throttle", "[throttle]" ) {
+    using namespace std::chrono_literals;
+
+    Throttle<int> throttle{100ms};
+
+    Throttle<int>::Clock::time_point start{};
+    throttle.start(start);
+
+    SECTION( "nothing is taken until change is offered" ) {
+        REQUIRE( !throttle.take(start + 1s) );
+        REQUIRE( !throttle.deadline() );
+    }
+
+    SECTION( "change within interval is held back until it passes" ) {
+        throttle.offer(1);
+
+        REQUIRE( !throttle.take(start + 50ms) );
+        REQUIRE( throttle.deadline() == start + 100ms );
+        REQUIRE( throttle.take(start + 100ms) == 1 );
+        REQUIRE( !throttle.deadline() );
+        REQUIRE( !throttle.take(start + 100ms) );
+    }
+
+    SECTION( "held back change is replaced by the latest one" ) {
+        throttle.offer(1);
+        throttle.offer(2);
+        throttle.offer(3);
+
+        REQUIRE( throttle.take(start + 120ms) == 3 );
+    }
+
+    SECTION( "at most one change is taken per interval" ) {
+        throttle.offer(1);
+        REQUIRE( throttle.take(start + 120ms) == 1 );
+
+        // interval starts again when change is taken
+        throttle.offer(2);
+
+        REQUIRE( !throttle.take(start + 200ms) );
+        REQUIRE( throttle.deadline() == start + 220ms );
+
+        throttle.offer(3);
+
+        REQUIRE( throttle.take(start + 220ms) == 3 );
+    }
+
+    SECTION( "change offered after interval passed is taken right away" ) {
+        throttle.offer(1);
+
+        REQUIRE( throttle.take(start + 1s) == 1 );
+        REQUIRE( throttle.deadline() == std::nullopt );
+
+        throttle.offer(2);
+
+        REQUIRE( throttle.take(start + 2s) == 2 );
+    }
+}
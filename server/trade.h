@@ -5,8 +5,8 @@ struct Trade {
     std::string product_id;
     std::string time;
     Side side;
-    std::string maker_order_id;
-    std::string taker_order_id;
+    OrderId maker_order_id;
+    OrderId taker_order_id;
     Decimal price;
     Decimal size;
 };
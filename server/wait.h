@@ -0,0 +1,286 @@
+#ifndef WAIT_H
+#define WAIT_H 1
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Producer and consumer state is kept on separate cache lines to avoid false sharing
+constexpr std::size_t cache_line_size = 64;
+
+// WaitStrategy controls how consumer waits for values.
+// Consumer busy-spins for `spin` iterations, then yields for `yield` iterations.
+// If `block` is set consumer is put to sleep afterwards, otherwise it keeps yielding till timeout.
+struct WaitStrategy {
+    std::uint32_t spin = 128;
+    std::uint32_t yield = 16;
+    bool block = true;
+
+    static constexpr WaitStrategy busy_spin() { return {.spin = UINT32_MAX, .yield = 0, .block = false}; };
+    static constexpr WaitStrategy blocking() { return {.spin = 0, .yield = 0, .block = true}; };
+
+    // parse returns strategy by name: "hybrid" (default), "spin" or "block"
+    static std::optional<WaitStrategy> parse(std::string_view name) {
+        if (name == "hybrid") {
+            return WaitStrategy{};
+        } else if (name == "spin") {
+            return busy_spin();
+        } else if (name == "block") {
+            return blocking();
+        }
+
+        return std::nullopt;
+    };
+};
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+// Signal wakes up consumers waiting for values published by producer.
+// Blocked consumers sleep on futex word that producer bumps only when some consumer is blocked,
+// so notification is a fence and a load while all consumers are spinning or busy.
+// Consumers that can not block (ie. stream reactors) watch the signal instead, producer invokes their watch once.
+// Platforms without futex fall back to condition variable.
+class Signal {
+public:
+    class Watch;
+
+    Signal() = default;
+    Signal(const Signal&) = delete;
+    Signal& operator=(const Signal&) = delete;
+
+    // notify wakes up all blocked consumers and invokes armed watches
+    // must be called after producer published value
+    void notify();
+
+    // wait_until waits till ready returns true following given strategy
+    // returns false if deadline expired before that
+    template<typename F>
+    bool wait_until(const WaitStrategy& wait, F&& ready, std::optional<std::chrono::steady_clock::time_point> deadline);
+
+    // watch arms watch to be invoked by the next notify, watch armed on other signal is disarmed there
+    // Returns false without arming watch if ready already returns true, consumer then takes values itself.
+    template<typename F>
+    bool watch(Watch& watch, F&& ready);
+
+    // unwatch disarms watch that was not invoked yet
+    void unwatch(Watch& watch);
+
+private:
+    std::atomic<std::uint32_t> waiters{0};
+    std::atomic<std::uint32_t> epoch{0};
+
+    // armed watches, watch_mtx is only taken by producer while some watch is armed
+    std::atomic<std::uint32_t> watchers{0};
+    std::mutex watch_mtx;
+    std::vector<Watch*> watches;
+
+#if !defined(__linux__)
+    std::mutex mtx;
+    std::condition_variable cv;
+#endif
+
+    // sleep till epoch changes from expected, spurious wakeups are allowed
+    void sleep(std::uint32_t expected, std::optional<std::chrono::steady_clock::time_point> deadline);
+};
+
+// Watch is callback of consumer that waits without blocking thread
+// Callback is invoked by producer with lock of signal held, so it should only schedule consumer and must not watch again.
+// Watch is disarmed when destroyed, so it has to be destroyed before signals it watched.
+class Signal::Watch {
+public:
+    explicit Watch(std::function<void()> callback): callback(std::move(callback)) {};
+
+    Watch(const Watch&) = delete;
+    Watch& operator=(const Watch&) = delete;
+
+    ~Watch() {
+        if (signal != nullptr) {
+            signal->unwatch(*this);
+        }
+    };
+
+private:
+    friend class Signal;
+
+    std::function<void()> callback;
+    // signal that watch was armed on, armed is guarded by its watch_mtx
+    Signal* signal = nullptr;
+    bool armed = false;
+};
+
+inline void Signal::notify() {
+    // pairs with fence in wait_until and watch, either consumer observes published value or producer observes waiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (watchers.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(watch_mtx);
+
+        for (auto watch: watches) {
+            watch->armed = false;
+            watch->callback();
+        }
+
+        watchers.fetch_sub(watches.size(), std::memory_order_relaxed);
+        watches.clear();
+    }
+
+    if (waiters.load(std::memory_order_relaxed)) {
+        epoch.fetch_add(1, std::memory_order_release);
+
+#if defined(__linux__)
+        syscall(SYS_futex, &epoch, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+        { std::lock_guard<std::mutex> lock(mtx); }
+        cv.notify_all();
+#endif
+    }
+}
+
+inline void Signal::unwatch(Watch& watch) {
+    std::lock_guard<std::mutex> lock(watch_mtx);
+
+    if (!watch.armed) {
+        return;
+    }
+
+    watches.erase(std::find(watches.begin(), watches.end(), &watch));
+    watchers.fetch_sub(1, std::memory_order_relaxed);
+    watch.armed = false;
+}
+
+template<typename F>
+bool Signal::watch(Watch& watch, F&& ready) {
+    // consumer may move its watch between signals, ie. from subscriber to snapshot it waits for
+    if (watch.signal != nullptr && watch.signal != this) {
+        watch.signal->unwatch(watch);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(watch_mtx);
+
+        if (!watch.armed) {
+            watch.signal = this;
+            watch.armed = true;
+            watches.push_back(&watch);
+            watchers.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // pairs with fence in notify, value published before watch was armed is observed by ready
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!ready()) {
+        return true;
+    }
+
+    unwatch(watch);
+    return false;
+}
+
+inline void Signal::sleep(std::uint32_t expected, std::optional<std::chrono::steady_clock::time_point> deadline) {
+#if defined(__linux__)
+    // futex timeout is relative
+    std::timespec ts{}, *timeout = nullptr;
+    if (deadline) {
+        auto remaining = std::max(*deadline - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero());
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+
+        ts.tv_sec = ns / 1000000000;
+        ts.tv_nsec = ns % 1000000000;
+        timeout = &ts;
+    }
+
+    syscall(SYS_futex, &epoch, FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+#else
+    std::unique_lock<std::mutex> lock(mtx);
+
+    auto changed = [&] { return epoch.load(std::memory_order_acquire) != expected; };
+    if (deadline) {
+        cv.wait_until(lock, *deadline, changed);
+    } else {
+        cv.wait(lock, changed);
+    }
+#endif
+}
+
+template<typename F>
+bool Signal::wait_until(const WaitStrategy& wait, F&& ready, std::optional<std::chrono::steady_clock::time_point> deadline) {
+    auto expired = [&deadline] {
+        return deadline && std::chrono::steady_clock::now() >= *deadline;
+    };
+
+    for (std::uint32_t i = 0; i < wait.spin; i++) {
+        if (ready()) {
+            return true;
+        }
+
+        // avoid reading clock on every iteration, the first one returns immediately if wait has no timeout
+        if (i % 64 == 0 && expired()) {
+            return false;
+        }
+
+        cpu_relax();
+    }
+
+    for (std::uint32_t i = 0; i < wait.yield || !wait.block; i++) {
+        if (ready()) {
+            return true;
+        }
+
+        if (expired()) {
+            return false;
+        }
+
+        std::this_thread::yield();
+    }
+
+    waiters.fetch_add(1, std::memory_order_relaxed);
+
+    bool res = false;
+    while (true) {
+        // epoch is read before ready so that notification after the check changes it and sleep returns immediately
+        auto expected = epoch.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (ready()) {
+            res = true;
+            break;
+        }
+
+        if (expired()) {
+            break;
+        }
+
+        sleep(expected, deadline);
+    }
+
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+
+    return res;
+}
+
+#endif
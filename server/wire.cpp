@@ -0,0 +1,186 @@
+#include "wire.h"
+
+#include <stdexcept>
+
+#include <grpcpp/impl/codegen/proto_utils.h>
+
+namespace {
+
+quote::OrderBookEntry map_orderbook_entry(const OrderBook::Entry& src) {
+    quote::OrderBookEntry dst;
+
+    dst.set_order_id(src.order_id.str());
+    dst.set_price(src.price.str());
+    dst.set_quantity(src.size.str());
+
+    return dst;
+};
+
+quote::Level2Entry map_level2_entry(const OrderBook::Level& src) {
+    quote::Level2Entry dst;
+
+    dst.set_price(src.price.str());
+    dst.set_quantity(src.size.str());
+    dst.set_count(src.count);
+
+    return dst;
+};
+
+} // anonymous namespace
+
+quote::OrderBook map_orderbook(const std::string& product_id, const OrderBook& src) {
+    quote::OrderBook dst;
+
+    dst.set_product_id(product_id);
+    dst.set_sequence(src.sequence());
+    dst.set_checksum(src.checksum());
+
+    auto bids = dst.mutable_bids();
+    bids->Reserve(src.bids().size());
+    for (const auto& entry: src.bids()) {
+        bids->Add(map_orderbook_entry(entry));
+    };
+
+    auto asks = dst.mutable_asks();
+    asks->Reserve(src.asks().size());
+    for (const auto& entry: src.asks()) {
+        asks->Add(map_orderbook_entry(entry));
+    };
+
+    return dst;
+};
+
+quote::OrderBook map_orderbook_update(const OrderBook::Update& src) {
+    quote::OrderBook dst;
+
+    dst.set_product_id(src.product_id);
+    dst.set_sequence(src.sequence);
+    dst.set_checksum(src.checksum);
+    dst.set_resync(src.resync);
+    dst.set_stale(src.stale);
+
+    if (src.bid) {
+        dst.mutable_bids()->Add(map_orderbook_entry(*src.bid));
+    };
+
+    if (src.ask) {
+        dst.mutable_asks()->Add(map_orderbook_entry(*src.ask));
+    };
+
+    return dst;
+};
+
+quote::OrderBook map_orderbook_delta(const Conflator::Delta& src) {
+    quote::OrderBook dst;
+
+    dst.set_product_id(src.product_id);
+    dst.set_sequence(src.sequence);
+    dst.set_checksum(src.checksum);
+
+    auto bids = dst.mutable_bids();
+    for (const auto& entry: src.bids) {
+        bids->Add(map_orderbook_entry(entry));
+    };
+
+    auto asks = dst.mutable_asks();
+    for (const auto& entry: src.asks) {
+        asks->Add(map_orderbook_entry(entry));
+    };
+
+    return dst;
+};
+
+quote::Level2 map_level2(const std::string& product_id, std::int64_t sequence, const std::vector<OrderBook::Level>& bids, const std::vector<OrderBook::Level>& asks) {
+    quote::Level2 dst;
+
+    dst.set_product_id(product_id);
+    dst.set_sequence(sequence);
+
+    for (const auto& level: bids) {
+        dst.mutable_bids()->Add(map_level2_entry(level));
+    };
+
+    for (const auto& level: asks) {
+        dst.mutable_asks()->Add(map_level2_entry(level));
+    };
+
+    return dst;
+};
+
+quote::TopOfBook map_top_of_book(const TopOfBook& src) {
+    quote::TopOfBook dst;
+
+    dst.set_product_id(src.product_id);
+    dst.set_sequence(src.sequence);
+    dst.set_stale(src.stale);
+
+    if (src.bid) {
+        *dst.mutable_bid() = map_level2_entry(*src.bid);
+    };
+
+    if (src.ask) {
+        *dst.mutable_ask() = map_level2_entry(*src.ask);
+    };
+
+    if (auto mid = src.mid()) {
+        dst.set_mid(mid->str());
+    };
+
+    if (auto spread = src.spread()) {
+        dst.set_spread(spread->str());
+    };
+
+    return dst;
+};
+
+quote::Trade map_trade(const Trade& src) {
+    quote::Trade dst;
+
+    dst.set_product_id(src.product_id);
+    dst.set_time(src.time);
+
+    switch (src.side) {
+    case Side::bid:
+        dst.set_side(quote::Side::BID); break;
+    case Side::ask:
+        dst.set_side(quote::Side::ASK); break;
+    };
+
+    dst.set_maker_order_id(src.maker_order_id.str());
+    dst.set_taker_order_id(src.taker_order_id.str());
+    dst.set_price(src.price.str());
+    dst.set_size(src.size.str());
+
+    return dst;
+};
+
+grpc::ByteBuffer serialize(const google::protobuf::MessageLite& src) {
+    grpc::ByteBuffer dst;
+    bool own_buffer;
+
+    auto status = grpc::SerializationTraits<google::protobuf::MessageLite>::Serialize(src, &dst, &own_buffer);
+    if (!status.ok()) {
+        throw std::runtime_error("serialize failed: " + status.error_message());
+    };
+
+    return dst;
+};
+
+bool parse(const grpc::ByteBuffer& src, google::protobuf::MessageLite& dst) {
+    // deserialization consumes buffer, copy only references its slices
+    grpc::ByteBuffer buffer{src};
+
+    return grpc::SerializationTraits<google::protobuf::MessageLite>::Deserialize(&buffer, &dst).ok();
+};
+
+const grpc::ByteBuffer& frame(const Message<OrderBook::Update>& src) {
+    return src->encode<grpc::ByteBuffer>([](const auto& update) { return serialize(map_orderbook_update(update)); });
+};
+
+const grpc::ByteBuffer& frame(const Message<Trade>& src) {
+    return src->encode<grpc::ByteBuffer>([](const auto& trade) { return serialize(map_trade(trade)); });
+};
+
+const grpc::ByteBuffer& frame(const Message<TopOfBook>& src) {
+    return src->encode<grpc::ByteBuffer>([](const auto& top) { return serialize(map_top_of_book(top)); });
+};
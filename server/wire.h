@@ -0,0 +1,34 @@
+#ifndef WIRE_H
+#define WIRE_H 1
+
+#include <string>
+
+#include <grpcpp/support/byte_buffer.h>
+
+#include "quote.pb.h"
+
+#include "conflator.h"
+#include "dispatcher.h"
+#include "orderbook.h"
+#include "trade.h"
+
+quote::OrderBook map_orderbook(const std::string& product_id, const OrderBook& src);
+quote::OrderBook map_orderbook_update(const OrderBook::Update& src);
+quote::OrderBook map_orderbook_delta(const Conflator::Delta& src);
+quote::Level2 map_level2(const std::string& product_id, std::int64_t sequence, const std::vector<OrderBook::Level>& bids, const std::vector<OrderBook::Level>& asks);
+quote::TopOfBook map_top_of_book(const TopOfBook& src);
+quote::Trade map_trade(const Trade& src);
+
+// serialize encodes protobuf message into wire-ready buffer
+grpc::ByteBuffer serialize(const google::protobuf::MessageLite& src);
+
+// parse decodes protobuf message from buffer, returns false if buffer is malformed
+bool parse(const grpc::ByteBuffer& src, google::protobuf::MessageLite& dst);
+
+// frame returns wire-ready encoding of message
+// message is encoded once and the buffer is shared by all streams writing it
+const grpc::ByteBuffer& frame(const Message<OrderBook::Update>& src);
+const grpc::ByteBuffer& frame(const Message<Trade>& src);
+const grpc::ByteBuffer& frame(const Message<TopOfBook>& src);
+
+#endif
@@ -0,0 +1,152 @@
+#include "wire.h"
+
+#include <grpcpp/impl/codegen/proto_utils.h>
+
+#include <catch2/catch.hpp>
+
+namespace {
+    OrderBook::Update make_update() {
+        return OrderBook::Update{
+            .product_id = "BTC-USD",
+            .sequence = 1,
+            .bid{{.order_id = "de43f91d-8db9-486e-868c-8389d2611ab0", .price = Decimal{"36206.76"}, .size = Decimal{"3009.99944762"}}},
+        };
+    };
+
+    template <typename T>
+    T deserialize(grpc::ByteBuffer buffer) {
+        T dst;
+        grpc::SerializationTraits<T>::Deserialize(&buffer, &dst);
+
+        return dst;
+    };
+} // anonymous namespace
+
+TEST_CASE( "OrderBook update is framed once", "[wire]" ) {
+    auto message = std::make_shared<const Envelope<OrderBook::Update>>(make_update());
+
+    const auto& f1 = frame(message);
+    const auto& f2 = frame(message);
+
+    REQUIRE( &f1 == &f2 );
+
+    auto decoded = deserialize<quote::OrderBook>(f1);
+
+    REQUIRE( decoded.product_id() == "BTC-USD" );
+    REQUIRE( decoded.sequence() == 1 );
+    REQUIRE( decoded.bids_size() == 1 );
+    REQUIRE( decoded.bids(0).order_id() == "de43f91d-8db9-486e-868c-8389d2611ab0" );
+    REQUIRE( decoded.asks_size() == 0 );
+    REQUIRE( !decoded.resync() );
+}
+
+TEST_CASE( "OrderBook resync and stale are mapped", "[wire]" ) {
+    auto decoded = deserialize<quote::OrderBook>(serialize(map_orderbook_update({
+        .product_id = "BTC-USD",
+        .sequence = 5,
+        .checksum = 42,
+        .resync = true,
+    })));
+
+    REQUIRE( decoded.sequence() == 5 );
+    REQUIRE( decoded.checksum() == 42 );
+    REQUIRE( decoded.resync() );
+    REQUIRE( !decoded.stale() );
+    REQUIRE( decoded.bids_size() == 0 );
+
+    auto stale = deserialize<quote::OrderBook>(serialize(map_orderbook_update({
+        .product_id = "BTC-USD",
+        .sequence = 4,
+        .stale = true,
+    })));
+
+    REQUIRE( stale.stale() );
+    REQUIRE( !stale.resync() );
+
+    auto top = deserialize<quote::TopOfBook>(serialize(map_top_of_book({
+        .product_id = "BTC-USD",
+        .sequence = 4,
+        .stale = true,
+    })));
+
+    REQUIRE( top.stale() );
+    REQUIRE( !top.has_bid() );
+}
+
+TEST_CASE( "OrderBook snapshot is mapped", "[wire]" ) {
+    OrderBook orderbook{7, std::vector<OrderBook::Entry>{
+        {.order_id = OrderId{0, 1}, .price = Decimal{"1.0"}, .size = Decimal{"1.0"}},
+    }, std::vector<OrderBook::Entry>{
+        {.order_id = OrderId{0, 2}, .price = Decimal{"2.0"}, .size = Decimal{"1.0"}},
+        {.order_id = OrderId{0, 3}, .price = Decimal{"3.0"}, .size = Decimal{"1.0"}},
+    }};
+
+    auto decoded = deserialize<quote::OrderBook>(serialize(map_orderbook("BTC-USD", orderbook)));
+
+    REQUIRE( decoded.product_id() == "BTC-USD" );
+    REQUIRE( decoded.sequence() == 7 );
+    REQUIRE( decoded.checksum() == orderbook.checksum() );
+    REQUIRE( decoded.bids_size() == 1 );
+    REQUIRE( decoded.bids(0).price() == "1" );
+    REQUIRE( decoded.asks_size() == 2 );
+    REQUIRE( decoded.asks(0).price() == "2" );
+}
+
+TEST_CASE( "TopOfBook is mapped", "[wire]" ) {
+    auto decoded = deserialize<quote::TopOfBook>(serialize(map_top_of_book({
+        .product_id = "BTC-USD",
+        .sequence = 3,
+        .bid = OrderBook::Level{.price = Decimal{"1.0"}, .size = Decimal{"3.0"}, .count = 2},
+        .ask = OrderBook::Level{.price = Decimal{"1.5"}, .size = Decimal{"1.0"}, .count = 1},
+    })));
+
+    REQUIRE( decoded.sequence() == 3 );
+    REQUIRE( decoded.bid().quantity() == "3" );
+    REQUIRE( decoded.bid().count() == 2 );
+    REQUIRE( decoded.ask().price() == "1.5" );
+    REQUIRE( decoded.mid() == "1.25" );
+    REQUIRE( decoded.spread() == "0.5" );
+
+    // one sided book has neither mid nor spread
+    auto bid_only = deserialize<quote::TopOfBook>(serialize(map_top_of_book({
+        .product_id = "BTC-USD",
+        .sequence = 4,
+        .bid = OrderBook::Level{.price = Decimal{"1.0"}, .size = Decimal{"3.0"}, .count = 2},
+    })));
+
+    REQUIRE( bid_only.has_bid() );
+    REQUIRE( !bid_only.has_ask() );
+    REQUIRE( bid_only.mid().empty() );
+}
+
+TEST_CASE( "OrderBook update fan-out", "[!benchmark][wire]" ) {
+    for (auto subscribers: {1, 10, 100, 500}) {
+        auto suffix = " (" + std::to_string(subscribers) + " subscribers)";
+
+        // every stream writes shared frame, ServerWriter::Write copies buffer by reference
+        BENCHMARK( "shared frame" + suffix ) {
+            auto message = std::make_shared<const Envelope<OrderBook::Update>>(make_update());
+
+            std::size_t size = 0;
+            for (int i = 0; i < subscribers; i++) {
+                grpc::ByteBuffer buffer{frame(message)};
+                size += buffer.Length();
+            }
+
+            return size;
+        };
+
+        // every stream maps and serializes update on its own
+        BENCHMARK( "per-stream encoding" + suffix ) {
+            auto update = make_update();
+
+            std::size_t size = 0;
+            for (int i = 0; i < subscribers; i++) {
+                auto buffer = serialize(map_orderbook_update(update));
+                size += buffer.Length();
+            }
+
+            return size;
+        };
+    }
+}